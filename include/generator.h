@@ -1,30 +1,149 @@
 #pragma once
 
 #include <parser_types.h>
+#include <ostream>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <unordered_set>
 
 
 namespace generator
 {
 
+struct GeneratorOptions
+{
+    size_t gain_group_min_size = 0; //same-level gains are emitted as one array loop if there are at least that many; 0 disables
+    size_t vector_alignment = 32; //alignment in bytes of vector signal arrays
+    bool simd_pragmas = false; //mark vector signal loops with "#pragma omp simd"
+    size_t subsystem_function_min_blocks = 0; //top-level subsystems with at least that many blocks get own functions; 0 inlines all
+    bool share_identical_subsystems = false; //structurally identical top-level subsystems are kept as one shared function
+    size_t struct_alignment = 64; //alignment in bytes of model struct, a cache line; 0 keeps natural alignment
+    bool pad_instance_state = false; //subsystem states start on own cache lines, so instances stepped by different threads don't share one
+    size_t output_chunk_blocks = 0; //code is split into files of about that many blocks, rewritten only where model changed since last run; 0 writes one file
+};
+
+struct SubsystemInstance
+{
+    std::string field; //name of instance's state in model struct, also prefix of its blocks names
+    std::string function; //name of state type and functions, identical instances share it
+    bool emits_function; //first of identical instances emits state type and functions
+    std::vector<std::shared_ptr<BaseBlock>> blocks; //in canonical order
+    std::vector<std::shared_ptr<BaseBlock>> inputs; //blocks outside of subsystem read by it, passed as parameters
+};
+
+enum ChunkKind: uint8_t
+{
+    OUTPUT_CHUNK = 0, // computes outputs of operations
+    UPDATE_CHUNK, // updates delay states
+    INIT_CHUNK // sets initial values of states and constants
+};
+
+struct OutputChunk
+{
+    std::string name; //suffix of chunk's function and file names
+    size_t rate; //index of rate group the chunk belongs to, 0 for init
+    ChunkKind kind;
+    std::vector<std::shared_ptr<BaseBlock>> blocks; //in call order
+    std::vector<size_t> block_levels; //dependency level of each block in step of chunk's rate, only for output chunks
+};
+
+struct CachedBlock
+{
+    uint64_t fingerprint;
+    uint64_t layout; //fingerprint of what main file takes from block
+    uint64_t level; //dependency level in step of block's rate, 0 if block isn't scheduled
+};
+
+//what chunked output was generated from last time, kept next to generated files
+struct ChunkCache
+{
+    uint64_t context = 0;
+    uint64_t main = 0; //fingerprint of rate periods and chunks called by main file
+    std::unordered_map<uint64_t, CachedBlock> blocks; //key of block's path - block record
+    std::unordered_map<std::string, uint64_t> chunks; //chunk name - fingerprint of its blocks list
+    std::filesystem::file_time_type written_time; //of cache file when kept in memory, a run by anyone else changes it
+};
+
 class Generator
 {
 
 public:
 
-    Generator(const ParserResult&& blocks);
+    Generator(ParserResult&& result, const GeneratorOptions& options = GeneratorOptions());
     void generate_code(const std::string& struct_name = "nwocg", const std::string& file_name = "nwocg");
+    void keep_chunk_cache(ChunkCache* cache); //long-running caller keeps schedule of chunked output between runs
 
 private:
 
-    void generate_headers(std::ofstream& fout, const std::string& file_name);
-    void generate_struct(std::ofstream& fout, const std::string& struct_name);
-    void generate_init_method(std::ofstream& fout, const std::string& struct_name);
-    void generate_step_method(std::ofstream& fout, const std::string& struct_name);
-    void generate_ext_ports(std::ofstream& fout, const std::string& struct_name);
+    void generate_headers(std::ostream& fout, const std::string& file_name);
+    void generate_struct(std::ostream& fout, const std::string& struct_name);
+    void generate_init_method(std::ostream& fout, const std::string& struct_name);
+    std::string generate_init_string(const std::shared_ptr<BaseBlock>& block_ptr, const std::string& struct_name);
+    void generate_subsystem_functions(std::ostream& fout, const std::string& struct_name);
+    void generate_step_method(std::ostream& fout, const std::string& struct_name);
+    std::vector<std::shared_ptr<BaseBlock>> rate_blocks(size_t rate);
+    std::string generate_rate_output_string(size_t rate, const std::string& struct_name);
+    std::string generate_rate_update_string(size_t rate, const std::string& struct_name);
+    void generate_ext_ports(std::ostream& fout, const std::string& struct_name);
+    void generate_chunked_code(const std::string& struct_name, const std::string& file_name);
+    std::string generate_chunk_string(const OutputChunk& chunk, const std::string& struct_name, const std::string& file_name);
+    std::string generate_chunk_calls_string(size_t rate, ChunkKind kind, const std::string& struct_name);
 
+    std::vector<std::shared_ptr<BaseBlock>> struct_layout();
+    std::string block_fields_string(const BaseBlock& block, const std::string& field_name, const std::string& prefix);
+    std::vector<std::vector<std::shared_ptr<BaseBlock>>> schedule_levels(const std::vector<std::shared_ptr<BaseBlock>>& scope_blocks, bool contract_functions);
+    size_t contracted_node(const BaseBlock& block);
+    std::set<size_t> looping_instances();
+    void schedule_rates();
+    bool is_scheduled(const BaseBlock& block);
+    uint64_t block_fingerprint(const BaseBlock& block);
+    uint64_t block_layout_fingerprint(const BaseBlock& block, size_t level);
+    std::unordered_set<size_t> downstream_cone(const std::unordered_set<size_t>& changed_sids);
+    void schedule_cone(const std::unordered_set<size_t>& cone, std::unordered_map<size_t, size_t>& node_levels);
+    void set_rate_levels(const std::unordered_map<size_t, size_t>& node_levels);
+    void split_chunks();
+    void warn_unobserved_blocks();
+    void assign_rates();
+    std::vector<size_t> rates_call_order();
+    void collect_subsystem_instances();
+    std::string canonical_form(std::vector<std::shared_ptr<BaseBlock>>& subsystem_blocks, std::vector<std::shared_ptr<BaseBlock>>& inputs);
+    std::string block_parameters_string(const BaseBlock& block);
+    std::string field_ref(const BaseBlock& block, const std::string& struct_name);
+    std::string signal_ref(const BaseBlock& block, const std::string& struct_name, const std::string& index = "i");
+    std::string generate_levels_string(const std::vector<std::vector<std::shared_ptr<BaseBlock>>>& levels, const std::string& struct_name);
+    std::string generate_unit_delay_string(const std::shared_ptr<BaseBlock>& block_ptr, const std::string& struct_name);
+    std::string generate_function_call_string(const SubsystemInstance& instance, const std::string& suffix, const std::string& struct_name);
+    bool is_function_call(const BaseBlock& block);
     std::string generate_step_method_string(const std::shared_ptr<BaseBlock>& block_ptr, const std::string& struct_name);
+    std::string generate_filter_string(const std::shared_ptr<BaseBlock>& block_ptr, const std::string& struct_name);
+    std::string generate_lookup_string(const std::shared_ptr<BaseBlock>& block_ptr, const std::string& struct_name);
+    std::string input_ref(const BaseBlock& input_block, const std::string& struct_name, const std::string& index = "i");
+    std::vector<std::shared_ptr<BaseBlock>> ordered_inputs(const OperationBlock& oper_block);
+    std::vector<std::shared_ptr<BaseBlock>> block_inputs(const BaseBlock& block);
+    void fold_constants();
+    double evaluate_operation(const OperationBlock& oper_block, const std::vector<double>& input_values);
+    std::string vector_loop_string(size_t width, const std::string& statement);
+    bool has_block_type(BlockType type);
+    bool has_vector_signals();
+    std::string generate_gain_group_string(const std::vector<std::shared_ptr<BaseBlock>>& gain_blocks, const std::string& struct_name);
+    std::string signs_string(const OperationBlock& oper_block);
 
-    ParserResult blocks;
+    std::map<size_t, std::shared_ptr<BaseBlock>> blocks; //ordered by sid, so emitted code doesn't depend on hash order
+    std::shared_ptr<BlockArena> arena; //owns blocks, inputs of blocks point into it
+    NameTable names; //names of blocks referred by ids
+    GeneratorOptions options;
+    std::unordered_map<size_t, std::vector<double>> constant_values; //sid - value of constant or folded block
+    std::vector<size_t> rate_periods; //periods of rate groups in base rate steps, base rate first
+    std::unordered_map<size_t, size_t> block_rates; //sid - index of block's rate group
+    std::vector<std::vector<std::vector<std::shared_ptr<BaseBlock>>>> rate_levels; //rate - operations of rate's step by dependency level
+    std::vector<OutputChunk> chunks; //init and step code split into files, in call order within rate
+    ChunkCache* kept_cache = nullptr; //cache of the last chunked run in memory of the caller, updated by every run
+    std::unordered_map<size_t, uint64_t> block_keys; //sid - hash of block's path, which identifies block between chunked runs
+    std::vector<SubsystemInstance> subsystem_instances;
+    std::unordered_map<size_t, size_t> block_instances; //sid - index of kept subsystem instance containing block
+    std::unordered_map<size_t, std::string> block_fields; //sid - field name inside subsystem state
+    const SubsystemInstance* current_instance = nullptr; //instance whose function is being emitted, its blocks are accessed through state pointer
 
 };
 
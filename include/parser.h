@@ -4,6 +4,7 @@
 
 #include <tinyxml2.h>
 #include <string>
+#include <map>
 
 namespace generator
 {
@@ -11,25 +12,63 @@ class Parser
 {
 public:
 
-    Parser(const std::string file_path);
+    Parser(const std::string file_path, int parse_threads = 0); // 0 parse threads means one per core
 
+    void load(const std::string& file_path); // replaces the document, reusing memory of the previous one
     ParserResult parse();
 
 private:
 
-    ParserResult parse_blocks(tinyxml2::XMLElement *root_xml);
+    struct Connection
+    {
+        std::shared_ptr<BaseBlock> src;
+        size_t src_port;
+        std::shared_ptr<BaseBlock> dst;
+        size_t dst_port;
+    };
+    using Drivers = std::map<std::pair<BaseBlock*, size_t>, const Connection*>; // dst block, dst port - line driving it
+    using SystemBlocks = std::unordered_map<size_t, std::shared_ptr<BaseBlock>>; // sid - block pointer
+
+    SystemBlocks parse_system(tinyxml2::XMLElement *system_xml, const std::string& scope);
+    SystemBlocks parse_blocks(tinyxml2::XMLElement *root_xml, const std::string& scope);
+    std::shared_ptr<BaseBlock> create_block(BlockType block_type, const std::string& scope);
+    void parse_subsystem(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml, const std::string& path);
     bool is_block_correct(const char* name, const char* sid, const char* type);
     std::shared_ptr<BaseBlock> parse_block(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml, const std::string& name, 
-                                           const std::string& sid, BlockType block_type);
+                                           size_t sid, BlockType block_type);
     void add_operation_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml);
+    void add_saturation_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml);
+    void add_switch_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml);
+    void add_constant_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml);
+    void add_filter_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml);
+    void add_lookup_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml);
+    std::vector<double> parse_coefficients(const std::string& coefficients_str, const std::string& what);
+    size_t parse_port_dimensions(const std::string& dimensions_str);
+    double parse_sample_time(const std::string& sample_time_str);
+
+
 
+    void parse_lines(SystemBlocks& blocks_ptr, tinyxml2::XMLElement *root_xml);
+    void parse_line(SystemBlocks& blocks_ptr, tinyxml2::XMLElement *line_xml);
+    void parse_branch(std::vector<std::pair<size_t, size_t>>& dsts, const SystemBlocks& blocks_ptr, tinyxml2::XMLElement *line_xml);
+    std::pair<size_t, size_t> parse_endpoint(const SystemBlocks& blocks_ptr, const char* endpoint_str);
 
+    void flatten_subsystems(SystemBlocks& blocks_ptr);
+    std::shared_ptr<BaseBlock> resolve_source(std::shared_ptr<BaseBlock> src, size_t src_port, const Drivers& drivers,
+                                              const std::unordered_map<BaseBlock*, std::pair<std::shared_ptr<BaseBlock>, size_t>>& boundary_inports);
+    void connect_blocks(const std::shared_ptr<BaseBlock>& src, const std::shared_ptr<BaseBlock>& dst, size_t dst_port);
 
-    void parse_lines(ParserResult& blocks_ptr, tinyxml2::XMLElement *root_xml);
-    void parse_line(ParserResult& blocks_ptr, tinyxml2::XMLElement *line_xml);
-    void parse_branch(std::vector<std::pair<uint8_t, size_t>>& dsts, const ParserResult& blocks_ptr, tinyxml2::XMLElement *line_xml);
+    void check_ports(const SystemBlocks& blocks_ptr);
+    void propagate_widths(SystemBlocks& blocks_ptr);
 
     tinyxml2::XMLDocument doc;
+
+    std::shared_ptr<BlockArena> arena; // blocks of the result being parsed
+    NameTable names; // names of the result being parsed
+
+    std::vector<Connection> connections; // lines of all systems, subsystem boundaries aren't resolved yet
+    std::vector<std::shared_ptr<SubSystemBlock>> subsystems;
+    std::vector<std::shared_ptr<BaseBlock>> nested_blocks; // blocks of non-root systems, except subsystem boundaries
 };
 
 }
\ No newline at end of file
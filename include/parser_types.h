@@ -1,33 +1,147 @@
 #pragma once
 #include <vector>
+#include <deque>
+#include <algorithm>
+#include <tuple>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <iostream>
+#include <stdexcept>
+#include <cstdint>
 
 namespace generator
 {
 
-enum BlockType
+enum BlockType: uint8_t
 {
     OUTPORT = 0,
     INPORT,
     SUM,
     GAIN,
-    UNIT_DELAY
+    UNIT_DELAY,
+    DISCRETE_FILTER,
+    LOOKUP,
+    PRODUCT,
+    SATURATION,
+    SWITCH,
+    CONSTANT,
+    SUBSYSTEM
+};
+
+enum SwitchCriteria: uint8_t
+{
+    GREATER_OR_EQUAL = 0, // u2 >= Threshold
+    GREATER, // u2 > Threshold
+    NOT_ZERO // u2 ~= 0
+};
+
+//every distinct name is stored once, blocks refer to it by 32-bit id; id 0 is the empty name
+class NameTable
+{
+public:
+    NameTable()
+    {
+        intern("");
+    }
+
+    uint32_t intern(std::string_view name)
+    {
+        if (4 * (offsets.size() + 1) > 3 * slots.size())
+        {
+            size_t slots_count = 64;
+            while (4 * (offsets.size() + 1) > 3 * slots_count)
+                slots_count *= 2;
+            rehash(slots_count);
+        }
+        for (size_t slot = hash(name) & (slots.size() - 1);; slot = (slot + 1) & (slots.size() - 1))
+        {
+            //slot keeps id + 1, 0 marks a free slot
+            if (slots[slot] == 0)
+            {
+                if (chars.size() + name.size() + 1 > UINT32_MAX)
+                    throw std::length_error("Parser: names don't fit in name table");
+                slots[slot] = static_cast<uint32_t>(offsets.size() + 1);
+                offsets.push_back(static_cast<uint32_t>(chars.size()));
+                chars.insert(chars.end(), name.begin(), name.end());
+                chars.push_back('\0');
+                return static_cast<uint32_t>(offsets.size() - 1);
+            }
+            if ((*this)[slots[slot] - 1] == name)
+                return slots[slot] - 1;
+        }
+    }
+
+    //pointer is valid until the next intern call
+    const char* operator[](uint32_t id) const
+    {
+        return chars.data() + offsets[id];
+    }
+
+    size_t size() const
+    {
+        return offsets.size();
+    }
+
+    //hash table is only needed to intern, it's rebuilt by the next intern call
+    void shrink_to_fit()
+    {
+        chars.shrink_to_fit();
+        offsets.shrink_to_fit();
+        std::vector<uint32_t>().swap(slots);
+    }
+
+private:
+    static size_t hash(std::string_view name)
+    {
+        //FNV-1a, the same in every build, unlike std::hash
+        uint64_t value = 14695981039346656037ull;
+        for (unsigned char c: name)
+            value = (value ^ c) * 1099511628211ull;
+        return static_cast<size_t>(value ^ value >> 32);
+    }
+
+    void rehash(size_t slots_count)
+    {
+        slots.assign(slots_count, 0);
+        for (uint32_t id = 0; id < offsets.size(); ++id)
+        {
+            size_t slot = hash((*this)[id]) & (slots_count - 1);
+            while (slots[slot] != 0)
+                slot = (slot + 1) & (slots_count - 1);
+            slots[slot] = id + 1;
+        }
+    }
+
+    std::vector<char> chars; // names one after another, each ends with '\0'
+    std::vector<uint32_t> offsets; // id - offset of name in chars
+    std::vector<uint32_t> slots; // open addressing hash table of ids, at most 3/4 full
 };
 
 struct BaseBlock
 {
-    std::string name;
+    uint32_t sid;
+    uint32_t name; // id in ParserResult::names of name inside enclosing subsystem, without spaces
+    uint32_t port_name; // id in ParserResult::names, if is_port = true
+    uint32_t subsystem; // id in ParserResult::names of path of enclosing subsystem like "Ctrl/PI", empty for root system
+    uint32_t width; // number of signal elements, 1 for scalar signal
     BlockType type;
-    size_t sid;
-    std::vector<std::weak_ptr<BaseBlock>> next_blocks;
     bool is_port;
-    std::string port_name; // if is_port = true
+    double sample_time; // period in seconds, -1 if inherited from inputs
     virtual ~BaseBlock() {};
 };
 
+//name of block in flattened model: its name prefixed with path of its subsystem like "Ctrl_PI_Gain"
+inline std::string block_name(const BaseBlock& block, const NameTable& names)
+{
+    std::string name = names[block.subsystem];
+    if (!name.empty())
+        name += '/';
+    std::replace(name.begin(), name.end(), '/', '_');
+    return name + names[block.name];
+}
+
 inline BlockType get_block_type(const std::string& type_str)
 {
     if (type_str == "Inport")
@@ -40,6 +154,20 @@ inline BlockType get_block_type(const std::string& type_str)
         return BlockType::SUM;
     else if (type_str == "UnitDelay")
         return BlockType::UNIT_DELAY;
+    else if (type_str == "DiscreteFilter")
+        return BlockType::DISCRETE_FILTER;
+    else if (type_str == "Lookup_n-D")
+        return BlockType::LOOKUP;
+    else if (type_str == "Product")
+        return BlockType::PRODUCT;
+    else if (type_str == "Saturate" || type_str == "Saturation")
+        return BlockType::SATURATION;
+    else if (type_str == "Switch")
+        return BlockType::SWITCH;
+    else if (type_str == "Constant")
+        return BlockType::CONSTANT;
+    else if (type_str == "SubSystem")
+        return BlockType::SUBSYSTEM;
     else
     {
         throw std::invalid_argument("Parser: invalid block type string " + type_str);
@@ -48,21 +176,167 @@ inline BlockType get_block_type(const std::string& type_str)
 
 inline bool is_operation(const BlockType& type)
 {
-    return type == BlockType::GAIN || type == BlockType::SUM;
+    return type == BlockType::GAIN || type == BlockType::SUM || type == BlockType::DISCRETE_FILTER ||
+           type == BlockType::LOOKUP || type == BlockType::PRODUCT || type == BlockType::SATURATION || type == BlockType::SWITCH;
 }
 
+//blocks driving input ports of an operation, input of port n is at n - 1; most operations have one or two, they are kept inline
+class InputPorts
+{
+public:
+    uint16_t declared = 0; // ports given by "Inputs" parameter of sum or product, 0 means any number
+
+    InputPorts() = default;
+    InputPorts(const InputPorts&) = delete;
+    InputPorts& operator=(const InputPorts&) = delete;
+
+    ~InputPorts()
+    {
+        if (count > inline_capacity)
+            delete[] heap_ports;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    BaseBlock* operator[](size_t port) const
+    {
+        return begin()[port];
+    }
+
+    BaseBlock*& operator[](size_t port)
+    {
+        return (count > inline_capacity ? heap_ports : inline_ports)[port];
+    }
+
+    BaseBlock* const* begin() const
+    {
+        return count > inline_capacity ? heap_ports : inline_ports;
+    }
+
+    BaseBlock* const* end() const
+    {
+        return begin() + count;
+    }
+
+    void resize(size_t new_count)
+    {
+        if (new_count > UINT16_MAX)
+            throw std::length_error("Parser: operation has more than 65535 input ports");
+        if (count <= inline_capacity && new_count <= inline_capacity)
+        {
+            for (size_t port = count; port < new_count; ++port)
+                inline_ports[port] = nullptr;
+        }
+        else
+        {
+            BaseBlock* *old_ports = count > inline_capacity ? heap_ports : nullptr;
+            BaseBlock* short_ports[inline_capacity] = {};
+            BaseBlock* *new_ports = new_count > inline_capacity ? new BaseBlock*[new_count]() : short_ports;
+            std::copy(begin(), begin() + std::min<size_t>(count, new_count), new_ports);
+            delete[] old_ports;
+            if (new_count > inline_capacity)
+                heap_ports = new_ports;
+            else
+                std::copy(short_ports, short_ports + inline_capacity, inline_ports);
+        }
+        count = static_cast<uint16_t>(new_count);
+    }
+
+    //port is inverted if its input is subtracted by sum or divides in product
+    bool is_inverted(size_t port) const
+    {
+        return port < 32 && (inverted >> port & 1);
+    }
+
+    void set_inverted(size_t port)
+    {
+        if (port >= 32)
+            throw std::invalid_argument("Parser: only first 32 inputs of sum or product may be subtracted or divide");
+        inverted |= uint32_t(1) << port;
+    }
+
+private:
+    static constexpr size_t inline_capacity = 2;
+
+    uint16_t count = 0;
+    uint32_t inverted = 0; // bit n - 1 is set if port n is inverted
+    union
+    {
+        BaseBlock* inline_ports[inline_capacity] = {};
+        BaseBlock* *heap_ports;
+    };
+};
+
 struct OperationBlock: BaseBlock
 {
-    std::string inputs; //for add operations it may have value like "+-"; empty string means "++"
-    std::unordered_map<uint8_t, std::weak_ptr<BaseBlock>> in_ports; // in_port-value
+    InputPorts in_ports; // also keeps signs of sum and product
     double gain; //for gain operation
 };
 
+struct DiscreteFilterBlock: OperationBlock
+{
+    std::vector<double> numerator; // b0..bN, normalized by denominator[0]
+    std::vector<double> denominator; // 1, a1..aM; size 1 means FIR filter
+};
+
+struct LookupBlock: OperationBlock
+{
+    std::vector<std::vector<double>> breakpoints; // one strictly increasing vector per table dimension (1 or 2)
+    std::vector<double> table; // row-major, first dimension is the slowest
+};
+
+struct SaturationBlock: OperationBlock
+{
+    double upper_limit;
+    double lower_limit;
+};
+
+struct SwitchBlock: OperationBlock
+{
+    SwitchCriteria criteria; // condition on control input (port 2) that passes port 1, otherwise port 3 is passed
+    double threshold;
+};
+
+struct ConstantBlock: BaseBlock
+{
+    std::vector<double> value; // one element per signal element
+};
+
+struct SubSystemBlock: BaseBlock
+{
+    std::unordered_map<size_t, std::shared_ptr<BaseBlock>> inports; // port number - Inport block of inner system
+    std::unordered_map<size_t, std::shared_ptr<BaseBlock>> outports; // port number - Outport block of inner system
+};
+
 struct UnitDelayBlock: BaseBlock
 {
-   std::weak_ptr<BaseBlock> input; 
+   BaseBlock* input = nullptr;
 };
 
-using ParserResult = std::unordered_map<size_t, std::shared_ptr<BaseBlock>>; //sid - block pointer
+//blocks of the parse result lie together by type, instead of a heap allocation and a control block each;
+//inputs of blocks point at blocks of the same arena, so they stay valid while it's alive
+class BlockArena
+{
+public:
+    template<typename Block>
+    Block& create()
+    {
+        return std::get<std::deque<Block>>(blocks).emplace_back();
+    }
+
+private:
+    std::tuple<std::deque<BaseBlock>, std::deque<OperationBlock>, std::deque<DiscreteFilterBlock>, std::deque<LookupBlock>,
+               std::deque<SaturationBlock>, std::deque<SwitchBlock>, std::deque<ConstantBlock>, std::deque<UnitDelayBlock>> blocks;
+};
+
+struct ParserResult
+{
+    std::vector<BaseBlock*> blocks; // flattened model ordered by sid
+    NameTable names; // names, port names and subsystem paths of blocks
+    std::shared_ptr<BlockArena> arena; // owns blocks
+};
 
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <generator.h>
+#include <parser.h>
+#include <memory>
+#include <string>
+
+namespace generator
+{
+class Watcher
+{
+public:
+
+    Watcher(const std::string& model_path, const std::string& file_name = "nwocg", const GeneratorOptions& options = GeneratorOptions());
+    ~Watcher();
+
+    void run();
+
+private:
+
+    void regenerate();
+    void handle_model_events();
+    void handle_request();
+
+    std::string model_path;
+    std::string file_name;
+    std::string socket_path;
+    GeneratorOptions options;
+    std::unique_ptr<Parser> parser; // kept between saves, so its document reuses memory
+    ChunkCache chunk_cache; // fingerprints and schedule of blocks from the last save, only changed ones are scheduled again
+
+    bool is_dirty = true; // model was saved after code was generated last time
+    std::string last_error;
+    int inotify_fd = -1;
+    int socket_fd = -1;
+};
+
+}
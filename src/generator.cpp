@@ -1,177 +1,1878 @@
 #include <generator.h>
 #include <fstream>
-#include <unordered_set>
+#include <sstream>
+#include <iostream>
 #include <queue>
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+
+namespace generator
+{
+
+namespace
+{
+
+//shortest text that reads back as the same double
+std::string double_literal(double value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    return buffer;
+}
+
+std::string coefficients_array(const std::string& name, const std::vector<double>& coefficients, size_t first)
+{
+    std::string array_code = "\t\tstatic const double " + name + "[" + std::to_string(coefficients.size() - first) + "] = { ";
+    for (size_t i = first; i < coefficients.size(); ++i)
+        array_code += double_literal(coefficients[i]) + (i + 1 < coefficients.size() ? ", " : " ");
+    return array_code + "};\n";
+}
+
+//breakpoints are uniform if every step equals the first one up to rounding
+bool is_uniform(const std::vector<double>& breakpoints)
+{
+    double step = (breakpoints.back() - breakpoints.front()) / (breakpoints.size() - 1);
+    for (size_t i = 1; i < breakpoints.size(); ++i)
+    {
+        if (std::fabs(breakpoints[i] - breakpoints[i - 1] - step) > 1e-9 * std::fabs(step))
+            return false;
+    }
+    return true;
+}
+
+//Tarjan's algorithm with explicit stack, so deep chains of blocks don't overflow call stack
+std::vector<std::vector<size_t>> strongly_connected_components(const std::vector<size_t>& nodes,
+                                                               std::unordered_map<size_t, std::vector<size_t>>& next_nodes)
+{
+    std::vector<std::vector<size_t>> components;
+    std::unordered_map<size_t, size_t> indices;
+    std::unordered_map<size_t, size_t> low_links;
+    std::unordered_set<size_t> on_stack;
+    std::vector<size_t> stack;
+    std::vector<std::pair<size_t, size_t>> call_stack; //node - index of its next edge to visit
+
+    auto visit = [&](size_t node)
+    {
+        size_t index = indices.size();
+        indices[node] = index;
+        low_links[node] = index;
+        stack.push_back(node);
+        on_stack.insert(node);
+        call_stack.push_back({node, 0});
+    };
+
+    for (size_t root: nodes)
+    {
+        if (indices.find(root) != indices.end())
+            continue;
+        visit(root);
+        while (!call_stack.empty())
+        {
+            size_t node = call_stack.back().first;
+            const auto& edges = next_nodes[node];
+            if (call_stack.back().second < edges.size())
+            {
+                size_t next_node = edges[call_stack.back().second++];
+                if (indices.find(next_node) == indices.end())
+                    visit(next_node);
+                else if (on_stack.find(next_node) != on_stack.end())
+                    low_links[node] = std::min(low_links[node], indices[next_node]);
+                continue;
+            }
+
+            call_stack.pop_back();
+            if (!call_stack.empty())
+                low_links[call_stack.back().first] = std::min(low_links[call_stack.back().first], low_links[node]);
+            if (low_links[node] != indices[node])
+                continue;
+            components.emplace_back();
+            size_t member;
+            do
+            {
+                member = stack.back();
+                stack.pop_back();
+                on_stack.erase(member);
+                components.back().push_back(member);
+            } while (member != node);
+        }
+    }
+    return components;
+}
+
+//shortest cycle from start back to it through nodes of its component
+std::vector<size_t> cycle_path(size_t start, const std::vector<size_t>& component,
+                               std::unordered_map<size_t, std::vector<size_t>>& next_nodes)
+{
+    std::unordered_set<size_t> members(component.begin(), component.end());
+    std::unordered_map<size_t, size_t> previous_nodes;
+    std::queue<size_t> queue;
+    queue.push(start);
+    while (!queue.empty())
+    {
+        size_t node = queue.front();
+        queue.pop();
+        for (size_t next_node: next_nodes[node])
+        {
+            if (next_node == start)
+            {
+                std::vector<size_t> path{start};
+                for (size_t path_node = node; path_node != start; path_node = previous_nodes[path_node])
+                    path.push_back(path_node);
+                std::reverse(path.begin() + 1, path.end());
+                path.push_back(start);
+                return path;
+            }
+            if (members.find(next_node) != members.end() && previous_nodes.insert({next_node, node}).second)
+                queue.push(next_node);
+        }
+    }
+    return {};
+}
+
+//FNV-1a, the same in every build, so fingerprints can be compared between runs
+uint64_t fnv1a(std::string_view text, uint64_t hash = 14695981039346656037ull)
+{
+    for (char c: text)
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    return hash;
+}
+
+//unchanged file keeps its modification time, so builds depending on it stay up to date
+void write_if_changed(const std::string& path, const std::string& code)
+{
+    std::ifstream fin(path, std::ios::binary);
+    std::ostringstream previous_code;
+    previous_code << fin.rdbuf();
+    if (fin.is_open() && previous_code.str() == code)
+        return;
+    fin.close();
+    std::ofstream fout(path, std::ios::binary);
+    fout << code;
+}
+
+//cache is a build artifact like object files, so numbers are stored as they are in memory
+const std::string chunk_cache_magic = "nwocg-chunk-cache 2\n";
+
+//missing or unreadable cache is empty, so everything is generated again
+ChunkCache read_chunk_cache(const std::string& path)
+{
+    std::ifstream fin(path, std::ios::binary);
+    std::ostringstream cache_stream;
+    cache_stream << fin.rdbuf();
+    std::string cache_data = cache_stream.str();
+
+    //reading past the end gives zeros and marks cache as broken
+    size_t position = chunk_cache_magic.size();
+    bool is_broken = cache_data.compare(0, position, chunk_cache_magic) != 0;
+    auto read_value = [&cache_data, &position, &is_broken]()
+    {
+        uint64_t value = 0;
+        is_broken = is_broken || position + sizeof(value) > cache_data.size();
+        if (!is_broken)
+            std::memcpy(&value, cache_data.data() + position, sizeof(value));
+        position += sizeof(value);
+        return value;
+    };
+
+    ChunkCache cache;
+    cache.context = read_value();
+    cache.main = read_value();
+    uint64_t blocks_count = read_value();
+    cache.blocks.reserve(std::min<uint64_t>(blocks_count, cache_data.size() / sizeof(uint64_t)));
+    for (uint64_t i = 0; i < blocks_count && !is_broken; ++i)
+    {
+        uint64_t key = read_value();
+        CachedBlock& block = cache.blocks[key];
+        block.fingerprint = read_value();
+        block.layout = read_value();
+        block.level = read_value();
+    }
+    uint64_t chunks_count = read_value();
+    for (uint64_t i = 0; i < chunks_count && !is_broken; ++i)
+    {
+        uint64_t name_size = read_value();
+        is_broken = is_broken || position + name_size > cache_data.size();
+        if (is_broken)
+            break;
+        std::string name = cache_data.substr(position, name_size);
+        position += name_size;
+        cache.chunks[name] = read_value();
+    }
+    if (is_broken)
+        return ChunkCache();
+    return cache;
+}
+
+void write_chunk_cache(const std::string& path, const ChunkCache& cache)
+{
+    std::string cache_data = chunk_cache_magic;
+    auto write_value = [&cache_data](uint64_t value)
+    {
+        cache_data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    write_value(cache.context);
+    write_value(cache.main);
+    write_value(cache.blocks.size());
+    for (const auto& [key, block]: cache.blocks)
+    {
+        write_value(key);
+        write_value(block.fingerprint);
+        write_value(block.layout);
+        write_value(block.level);
+    }
+    write_value(cache.chunks.size());
+    for (const auto& [name, members]: cache.chunks)
+    {
+        write_value(name.size());
+        cache_data += name;
+        write_value(members);
+    }
+    std::ofstream fout(path, std::ios::binary);
+    fout << cache_data;
+}
+
+}
+
+Generator::Generator(ParserResult&& result, const GeneratorOptions& options)
+{
+    //block pointers share ownership of the arena, so blocks live as long as any of them is used
+    for (BaseBlock* block: result.blocks)
+        blocks.insert(blocks.end(), {block->sid, std::shared_ptr<BaseBlock>(result.arena, block)});
+    arena = std::move(result.arena);
+    names = std::move(result.names);
+    this->options = options;
+}
+
+
+void Generator::keep_chunk_cache(ChunkCache* cache)
+{
+    kept_cache = cache;
+}
+
+void Generator::generate_code(const std::string& struct_name, const std::string& file_name)
+{
+    fold_constants();
+    warn_unobserved_blocks();
+    assign_rates();
+    collect_subsystem_instances();
+    if (options.output_chunk_blocks > 0)
+    {
+        generate_chunked_code(struct_name, file_name);
+        return;
+    }
+    schedule_rates();
+
+    std::ostringstream code;
+    generate_headers(code, file_name);
+    generate_struct(code, struct_name);
+    generate_init_method(code, struct_name);
+    generate_subsystem_functions(code, struct_name);
+    generate_step_method(code, struct_name);
+    generate_ext_ports(code, struct_name);
+    write_if_changed(file_name + ".c", code.str());
+
+    //files of an earlier chunked run would define the same symbols, so they go away with their cache
+    ChunkCache previous_cache = read_chunk_cache(file_name + ".cache");
+    for (const auto& [name, _]: previous_cache.chunks)
+        std::remove((file_name + "_" + name + ".c").c_str());
+    if (!previous_cache.chunks.empty())
+        std::remove((file_name + "_model.h").c_str());
+    std::remove((file_name + ".cache").c_str());
+}
+
+void Generator::generate_chunked_code(const std::string& struct_name, const std::string& file_name)
+{
+    //a kept instance is one node of step but many blocks of fingerprints and chunks, which the cache can't tell apart
+    if (options.subsystem_function_min_blocks > 0 || options.share_identical_subsystems)
+        throw std::invalid_argument("Generator: chunked output inlines subsystems, it can't be combined with subsystem functions");
+
+    //code of chunks depends on these besides blocks, any change of them makes every block changed
+    ChunkCache cache;
+    cache.context = fnv1a(struct_name + ":" + file_name + ":" + std::to_string(options.simd_pragmas) + ":" +
+                          std::to_string(options.gain_group_min_size) + ":" + std::to_string(options.output_chunk_blocks));
+    //cache kept in memory is the one written last time, so the file isn't read back unless another run has rewritten it
+    std::error_code time_error;
+    bool is_kept_cache_current = kept_cache && kept_cache->context == cache.context &&
+                                 std::filesystem::last_write_time(file_name + ".cache", time_error) == kept_cache->written_time && !time_error;
+    ChunkCache previous_cache = is_kept_cache_current ? std::move(*kept_cache) : read_chunk_cache(file_name + ".cache");
+    if (previous_cache.context != cache.context)
+        previous_cache.blocks.clear();
+
+    //sids of nested blocks follow document order and shift when a block is added before them, so blocks are matched by paths
+    block_keys.clear();
+    block_keys.reserve(blocks.size());
+    for (const auto& [sid, block_ptr]: blocks)
+        block_keys[sid] = fnv1a(names[block_ptr->name], fnv1a("/", fnv1a(names[block_ptr->subsystem])));
+
+    //block is changed if its fingerprint differs from the last run; scheduled block without a level is treated as changed too
+    std::unordered_set<size_t> changed_sids;
+    std::unordered_map<size_t, size_t> node_levels; //sid - dependency level of scheduled block
+    node_levels.reserve(blocks.size());
+    cache.blocks.reserve(blocks.size());
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        CachedBlock block = {block_fingerprint(*block_ptr), 0, 0};
+        auto cached_block = previous_cache.blocks.find(block_keys[sid]);
+        if (cached_block == previous_cache.blocks.end() || cached_block->second.fingerprint != block.fingerprint ||
+            (is_scheduled(*block_ptr) && cached_block->second.level == 0))
+            changed_sids.insert(sid);
+        else
+            block = cached_block->second;
+        if (!cache.blocks.insert({block_keys[sid], block}).second)
+            throw std::invalid_argument("Generator: block " + block_name(*block_ptr, names) + " has the same path as another block");
+        if (block.level > 0)
+            node_levels[sid] = block.level;
+    }
+
+    //only changed blocks and blocks reading them are scheduled again, others keep levels of the last run
+    std::unordered_set<size_t> cone = downstream_cone(changed_sids);
+    schedule_cone(cone, node_levels);
+    set_rate_levels(node_levels);
+    split_chunks();
+
+    //main file holds fields in layout order, calls of chunks and ext ports; blocks changed only in values, like gains, leave it as is
+    cache.main = fnv1a(std::to_string(rate_periods.size()));
+    for (size_t period: rate_periods)
+        cache.main = fnv1a(" " + std::to_string(period), cache.main);
+    for (const auto& chunk: chunks)
+        cache.main = fnv1a(" " + chunk.name + ":" + std::to_string(chunk.rate), cache.main);
+    bool is_main_changed = cache.main != previous_cache.main || blocks.size() != previous_cache.blocks.size() ||
+                           !std::ifstream(file_name + ".c").is_open();
+    for (size_t sid: cone)
+    {
+        CachedBlock& block = cache.blocks[block_keys[sid]];
+        auto level = node_levels.find(sid);
+        block.level = level == node_levels.end() ? 0 : level->second;
+        block.layout = block_layout_fingerprint(*blocks[sid], block.level);
+        auto cached_block = previous_cache.blocks.find(block_keys[sid]);
+        is_main_changed = is_main_changed || cached_block == previous_cache.blocks.end() || cached_block->second.layout != block.layout;
+    }
+
+    std::ostringstream model_header;
+    model_header << "#pragma once\n\n";
+    generate_headers(model_header, file_name);
+    write_if_changed(file_name + "_model.h", model_header.str());
+
+    if (is_main_changed)
+    {
+        std::ostringstream code;
+        code << "#include \"" << file_name << "_model.h\"\n";
+        generate_struct(code, struct_name);
+        code << "\n";
+        for (const auto& chunk: chunks)
+            code << "void " << struct_name << "_" << chunk.name << "();\n";
+        generate_init_method(code, struct_name);
+        generate_step_method(code, struct_name);
+        generate_ext_ports(code, struct_name);
+        write_if_changed(file_name + ".c", code.str());
+    }
+
+    //chunk keeping its blocks, none of them changed, has the same code, so it isn't even generated
+    for (const auto& chunk: chunks)
+    {
+        uint64_t members = fnv1a("");
+        bool has_changes = false;
+        for (const auto& block_ptr: chunk.blocks)
+        {
+            members = fnv1a(std::string_view(reinterpret_cast<const char*>(&block_keys[block_ptr->sid]), sizeof(uint64_t)), members);
+            has_changes = has_changes || cone.find(block_ptr->sid) != cone.end();
+        }
+        cache.chunks[chunk.name] = members;
+
+        std::string chunk_path = file_name + "_" + chunk.name + ".c";
+        auto cached_chunk = previous_cache.chunks.find(chunk.name);
+        if (has_changes || cached_chunk == previous_cache.chunks.end() || cached_chunk->second != members || !std::ifstream(chunk_path).is_open())
+            write_if_changed(chunk_path, generate_chunk_string(chunk, struct_name, file_name));
+    }
+    for (const auto& [name, _]: previous_cache.chunks)
+    {
+        if (cache.chunks.find(name) == cache.chunks.end())
+            std::remove((file_name + "_" + name + ".c").c_str());
+    }
+
+    //cache is written last, so after a failed run chunks written so far are still seen as changed
+    write_chunk_cache(file_name + ".cache", cache);
+    if (kept_cache)
+    {
+        cache.written_time = std::filesystem::last_write_time(file_name + ".cache", time_error);
+        *kept_cache = std::move(cache);
+    }
+}
+
+std::string Generator::generate_chunk_string(const OutputChunk& chunk, const std::string& struct_name, const std::string& file_name)
+{
+    //fields of chunk's blocks and of their inputs, except scalar constants substituted as literals
+    std::string declarations_code;
+    std::unordered_set<size_t> declared;
+    auto declare = [this, &struct_name, &declarations_code, &declared](const BaseBlock& block)
+    {
+        bool is_literal = block.width == 1 && constant_values.find(block.sid) != constant_values.end();
+        if (!is_literal && declared.insert(block.sid).second)
+            declarations_code += block_fields_string(block, field_ref(block, struct_name), "extern ");
+    };
+
+    std::string function_code;
+    std::vector<std::vector<std::shared_ptr<BaseBlock>>> levels(1); //levels of the part of rate's step in output chunk, renumbered from 1
+    for (size_t i = 0; i < chunk.blocks.size(); ++i)
+    {
+        const auto& block_ptr = chunk.blocks[i];
+        if (chunk.kind == INIT_CHUNK)
+        {
+            //constants are substituted into step code, but their fields are still set for ext ports and vector consumers
+            declarations_code += block_fields_string(*block_ptr, field_ref(*block_ptr, struct_name), "extern ");
+            function_code += generate_init_string(block_ptr, struct_name);
+            continue;
+        }
+        declare(*block_ptr);
+        for (const auto& input_ptr: block_inputs(*block_ptr))
+            declare(*input_ptr);
+        if (chunk.kind == UPDATE_CHUNK)
+        {
+            function_code += generate_unit_delay_string(block_ptr, struct_name);
+            continue;
+        }
+        if (i == 0 || chunk.block_levels[i] != chunk.block_levels[i - 1])
+            levels.emplace_back();
+        levels.back().push_back(block_ptr);
+    }
+    //output chunk is emitted by levels like single file step, so same-level gains of the chunk are grouped too
+    if (chunk.kind == OUTPUT_CHUNK)
+        function_code = generate_levels_string(levels, struct_name);
+    return "#include \"" + file_name + "_model.h\"\n\n" + declarations_code + "\nvoid " + struct_name + "_" + chunk.name + "()\n{\n" +
+           function_code + "}\n";
+}
+
+std::string Generator::generate_chunk_calls_string(size_t rate, ChunkKind kind, const std::string& struct_name)
+{
+    std::string calls_code;
+    for (const auto& chunk: chunks)
+    {
+        if (chunk.rate == rate && chunk.kind == kind)
+            calls_code += "\t" + struct_name + "_" + chunk.name + "();\n";
+    }
+    return calls_code;
+}
+
+void Generator::generate_headers(std::ostream& fout, const std::string& file_name)
+{
+    std::string headers_code = "";
+    headers_code += "#include \"" + file_name + "_run.h\"\n";
+    headers_code += "#include <math.h>\n";
+    bool has_filters = has_block_type(BlockType::DISCRETE_FILTER);
+    if (has_vector_signals() || has_filters)
+    {
+        headers_code += "\n#if defined(__GNUC__)\n#define NWOCG_ALIGNED __attribute__((aligned(" + std::to_string(options.vector_alignment) + ")))\n";
+        headers_code += "#else\n#define NWOCG_ALIGNED\n#endif\n";
+    }
+    if (options.struct_alignment > 0 || (options.pad_instance_state && !subsystem_instances.empty()))
+    {
+        //padding instance states needs some line size even when the struct keeps natural alignment
+        size_t alignment = options.struct_alignment > 0 ? options.struct_alignment : 64;
+        if ((alignment & (alignment - 1)) != 0)
+            throw std::invalid_argument("Generator: struct alignment isn't a power of two: " + std::to_string(alignment));
+        headers_code += "\n#if defined(__GNUC__)\n#define NWOCG_CACHE_ALIGNED __attribute__((aligned(" + std::to_string(alignment) + ")))\n";
+        headers_code += "#else\n#define NWOCG_CACHE_ALIGNED\n#endif\n";
+    }
+    if (has_filters)
+    {
+        //four independent accumulators break the add dependency chain and map onto SIMD lanes
+        headers_code += "\nstatic inline double nwocg_dot(const double* restrict coefs, const double* restrict window, int n)\n{\n";
+        headers_code += "\tdouble acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;\n";
+        headers_code += "\tint k = 0;\n";
+        headers_code += "\tfor (; k + 4 <= n; k += 4)\n\t{\n";
+        headers_code += "\t\tacc0 += coefs[k] * window[k];\n";
+        headers_code += "\t\tacc1 += coefs[k + 1] * window[k + 1];\n";
+        headers_code += "\t\tacc2 += coefs[k + 2] * window[k + 2];\n";
+        headers_code += "\t\tacc3 += coefs[k + 3] * window[k + 3];\n";
+        headers_code += "\t}\n";
+        headers_code += "\tfor (; k < n; ++k)\n\t\tacc0 += coefs[k] * window[k];\n";
+        headers_code += "\treturn (acc0 + acc1) + (acc2 + acc3);\n}\n";
+    }
+    if (has_block_type(BlockType::LOOKUP))
+    {
+        //index of the segment containing u, clamped to [0, n - 2]; halving without branches compiles to cmov
+        headers_code += "\nstatic inline int nwocg_bsearch(const double* bp, int n, double u)\n{\n";
+        headers_code += "\tconst double* base = bp;\n";
+        headers_code += "\tint len = n - 1;\n";
+        headers_code += "\twhile (len > 1)\n\t{\n";
+        headers_code += "\t\tint half = len / 2;\n";
+        headers_code += "\t\tbase = base[half] <= u ? base + half : base;\n";
+        headers_code += "\t\tlen -= half;\n";
+        headers_code += "\t}\n";
+        headers_code += "\treturn (int)(base - bp);\n}\n";
+    }
+    fout << headers_code;
+}
+
+void Generator::generate_struct(std::ostream& fout, const std::string& struct_name)
+{
+    std::string struct_code;
+    for (const auto& instance: subsystem_instances)
+    {
+        if (!instance.emits_function)
+            continue;
+        struct_code += "\ntypedef struct\n{\n";
+        for (const auto& block_ptr: instance.blocks)
+            struct_code += block_fields_string(*block_ptr, block_fields[block_ptr->sid], "\t");
+        struct_code += options.pad_instance_state ? "} NWOCG_CACHE_ALIGNED " : "} ";
+        struct_code += struct_name + "_" + instance.function + "_state;\n";
+    }
+
+    if (options.output_chunk_blocks > 0)
+    {
+        //chunk files declare only fields they use, which can't be done with a struct, so fields are globals defined in the same order
+        struct_code += "\n";
+        for (const auto& block_ptr: struct_layout())
+            struct_code += block_fields_string(*block_ptr, field_ref(*block_ptr, struct_name), "");
+    }
+    else
+    {
+        struct_code += "\nstatic struct\n{\n";
+        for (const auto& block_ptr: struct_layout())
+            struct_code += block_fields_string(*block_ptr, block_name(*block_ptr, names), "\t");
+        for (const auto& instance: subsystem_instances)
+            struct_code += "\t" + struct_name + "_" + instance.function + "_state " + instance.field + ";\n";
+        struct_code += options.struct_alignment > 0 ? "} " + struct_name + " NWOCG_CACHE_ALIGNED;\n" : "} " + struct_name + ";\n";
+    }
+    if (rate_periods.size() > 1)
+        struct_code += "\nstatic unsigned int " + struct_name + "_rate_counters[" + std::to_string(rate_periods.size()) + "];\n";
+    fout << struct_code;
+}
+
+std::vector<std::shared_ptr<BaseBlock>> Generator::struct_layout()
+{
+    //hot data first: signals follow order of first use in step, so blocks computed together share cache lines,
+    //then delay states, which are read and written every step too; constants and unused blocks are cold and go last
+    std::vector<std::shared_ptr<BaseBlock>> layout;
+    std::unordered_set<size_t> placed;
+    auto place = [this, &layout, &placed](const std::shared_ptr<BaseBlock>& block_ptr)
+    {
+        bool is_delay_state = block_ptr->type == BlockType::UNIT_DELAY;
+        bool is_cold = constant_values.find(block_ptr->sid) != constant_values.end();
+        if (!is_delay_state && !is_cold && block_instances.find(block_ptr->sid) == block_instances.end() && placed.insert(block_ptr->sid).second)
+            layout.push_back(block_ptr);
+    };
+
+    for (size_t rate: rates_call_order())
+    {
+        for (const auto& level_blocks: rate_levels[rate])
+        {
+            for (const auto& block_ptr: level_blocks)
+            {
+                const auto& inputs = is_function_call(*block_ptr) ? subsystem_instances[block_instances[block_ptr->sid]].inputs : block_inputs(*block_ptr);
+                for (const auto& input_ptr: inputs)
+                    place(input_ptr);
+                place(block_ptr);
+            }
+        }
+    }
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        if (block_ptr->type == BlockType::UNIT_DELAY && block_instances.find(sid) == block_instances.end() && placed.insert(sid).second)
+            layout.push_back(block_ptr);
+    }
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        if (block_instances.find(sid) == block_instances.end() && placed.insert(sid).second)
+            layout.push_back(block_ptr);
+    }
+    return layout;
+}
+
+std::string Generator::block_fields_string(const BaseBlock& block, const std::string& field_name, const std::string& prefix)
+{
+    //prefix is indent of struct members or storage class of globals
+    std::string fields_code;
+    if (block.width > 1)
+        fields_code += prefix + "double " + field_name + "[" + std::to_string(block.width) + "] NWOCG_ALIGNED;\n";
+    else
+        fields_code += prefix + "double " + field_name + ";\n";
+
+    if (block.type == BlockType::DISCRETE_FILTER)
+    {
+        //histories are stored twice in a row, so window of last samples is always contiguous
+        const auto& filter_block = dynamic_cast<const DiscreteFilterBlock&>(block);
+        size_t x_size = filter_block.numerator.size();
+        size_t y_size = filter_block.denominator.size() - 1;
+        fields_code += prefix + "double " + field_name + "_x[" + std::to_string(2 * x_size) + "] NWOCG_ALIGNED;\n";
+        fields_code += prefix + "int " + field_name + "_x_pos;\n";
+        if (y_size > 0)
+        {
+            fields_code += prefix + "double " + field_name + "_y[" + std::to_string(2 * y_size) + "] NWOCG_ALIGNED;\n";
+            fields_code += prefix + "int " + field_name + "_y_pos;\n";
+        }
+    }
+    return fields_code;
+}
+
+void Generator::generate_init_method(std::ostream& fout, const std::string& struct_name)
+{
+    std::string init_code = "\nvoid " + struct_name + "_generated_init()\n{\n";
+    if (options.output_chunk_blocks > 0)
+    {
+        init_code += generate_chunk_calls_string(0, INIT_CHUNK, struct_name);
+    }
+    else
+    {
+        for (const auto& [_, block_ptr]: blocks)
+            init_code += generate_init_string(block_ptr, struct_name);
+    }
+    if (rate_periods.size() > 1)
+        init_code += vector_loop_string(rate_periods.size(), struct_name + "_rate_counters[i] = 0;\n");
+    init_code += "}\n";
+    fout << init_code;
+}
+
+std::string Generator::generate_init_string(const std::shared_ptr<BaseBlock>& block_ptr, const std::string& struct_name)
+{
+    std::string init_code;
+    if (block_ptr->type == BlockType::UNIT_DELAY)
+    {
+        init_code += vector_loop_string(block_ptr->width, signal_ref(*block_ptr, struct_name) + " = 0;\n");
+    }
+    else if (constant_values.find(block_ptr->sid) != constant_values.end())
+    {
+        //folded values are kept in struct too, so ext ports and vector consumers can read them
+        const auto& value = constant_values[block_ptr->sid];
+        for (size_t i = 0; i < value.size(); ++i)
+            init_code += "\t" + signal_ref(*block_ptr, struct_name, std::to_string(i)) + " = " + double_literal(value[i]) + ";\n";
+    }
+    else if (block_ptr->type == BlockType::DISCRETE_FILTER)
+    {
+        std::shared_ptr<DiscreteFilterBlock> filter_block_ptr = std::dynamic_pointer_cast<DiscreteFilterBlock>(block_ptr);
+        size_t x_size = filter_block_ptr->numerator.size();
+        size_t y_size = filter_block_ptr->denominator.size() - 1;
+        std::string field = field_ref(*block_ptr, struct_name);
+        init_code += vector_loop_string(2 * x_size, field + "_x[i] = 0;\n");
+        init_code += "\t" + field + "_x_pos = 0;\n";
+        if (y_size > 0)
+        {
+            init_code += vector_loop_string(2 * y_size, field + "_y[i] = 0;\n");
+            init_code += "\t" + field + "_y_pos = 0;\n";
+        }
+    }
+    return init_code;
+}
+
+void Generator::generate_subsystem_functions(std::ostream& fout, const std::string& struct_name)
+{
+    std::string functions_code;
+    for (const auto& instance: subsystem_instances)
+    {
+        if (!instance.emits_function)
+            continue;
+        std::string parameters = "(" + struct_name + "_" + instance.function + "_state* s";
+        for (size_t i = 0; i < instance.inputs.size(); ++i)
+            parameters += (instance.inputs[i]->width > 1 ? ", const double* in" : ", double in") + std::to_string(i);
+        parameters += ")";
+
+        current_instance = &instance;
+        std::string output_code = generate_levels_string(schedule_levels(instance.blocks, false), struct_name);
+        std::string update_code;
+        for (const auto& block_ptr: instance.blocks)
+        {
+            if (block_ptr->type == BlockType::UNIT_DELAY)
+                update_code += generate_unit_delay_string(block_ptr, struct_name);
+        }
+        current_instance = nullptr;
+
+        //states are updated separately, so outputs read by other blocks keep previous step values until the step ends
+        functions_code += "\nstatic void " + struct_name + "_" + instance.function + "_output" + parameters + "\n{\n" + output_code + "}\n";
+        functions_code += "\nstatic void " + struct_name + "_" + instance.function + "_update" + parameters + "\n{\n" + update_code + "}\n";
+    }
+    fout << functions_code;
+}
+
+void Generator::generate_step_method(std::ostream& fout, const std::string& struct_name)
+{
+    std::string method_code;
+    if (rate_periods.size() == 1)
+    {
+        method_code += "\nvoid " + struct_name + "_generated_step()\n{\n";
+        method_code += generate_rate_output_string(0, struct_name) + generate_rate_update_string(0, struct_name);
+        method_code += "}\n";
+        fout << method_code;
+        return;
+    }
+
+    //every rate group gets own functions, base rate step runs those whose period has elapsed
+    for (size_t rate = 0; rate < rate_periods.size(); ++rate)
+    {
+        std::string function_name = struct_name + "_rate" + std::to_string(rate);
+        method_code += "\nstatic void " + function_name + "_output()\n{\n" + generate_rate_output_string(rate, struct_name) + "}\n";
+        method_code += "\nstatic void " + function_name + "_update()\n{\n" + generate_rate_update_string(rate, struct_name) + "}\n";
+    }
+
+    auto rate_call = [&struct_name](size_t rate, const std::string& suffix)
+    {
+        std::string call_code = struct_name + "_rate" + std::to_string(rate) + suffix + "();\n";
+        if (rate == 0)
+            return "\t" + call_code;
+        return "\tif (" + struct_name + "_rate_counters[" + std::to_string(rate) + "] == 0)\n\t\t" + call_code;
+    };
+
+    method_code += "\nvoid " + struct_name + "_generated_step()\n{\n";
+    for (size_t rate: rates_call_order())
+        method_code += rate_call(rate, "_output");
+    for (size_t rate = 0; rate < rate_periods.size(); ++rate)
+        method_code += rate_call(rate, "_update");
+    for (size_t rate = 1; rate < rate_periods.size(); ++rate)
+    {
+        std::string counter = struct_name + "_rate_counters[" + std::to_string(rate) + "]";
+        method_code += "\tif (++" + counter + " == " + std::to_string(rate_periods[rate]) + ")\n\t\t" + counter + " = 0;\n";
+    }
+    method_code += "}\n";
+    fout << method_code;
+}
+
+std::vector<std::shared_ptr<BaseBlock>> Generator::rate_blocks(size_t rate)
+{
+    std::vector<std::shared_ptr<BaseBlock>> blocks_of_rate;
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        if (block_rates[sid] == rate)
+            blocks_of_rate.push_back(block_ptr);
+    }
+    return blocks_of_rate;
+}
+
+std::string Generator::generate_rate_output_string(size_t rate, const std::string& struct_name)
+{
+    if (options.output_chunk_blocks > 0)
+        return generate_chunk_calls_string(rate, OUTPUT_CHUNK, struct_name);
+    return generate_levels_string(rate_levels[rate], struct_name);
+}
+
+std::string Generator::generate_rate_update_string(size_t rate, const std::string& struct_name)
+{
+    if (options.output_chunk_blocks > 0)
+        return generate_chunk_calls_string(rate, UPDATE_CHUNK, struct_name);
+    std::string update_code;
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        if (block_ptr->type == BlockType::UNIT_DELAY && block_rates[sid] == rate && block_instances.find(sid) == block_instances.end())
+            update_code += generate_unit_delay_string(block_ptr, struct_name);
+    }
+    for (const auto& instance: subsystem_instances)
+    {
+        if (block_rates[instance.blocks.front()->sid] == rate)
+            update_code += "\t" + generate_function_call_string(instance, "_update", struct_name);
+    }
+    return update_code;
+}
+
+std::string Generator::generate_levels_string(const std::vector<std::vector<std::shared_ptr<BaseBlock>>>& levels, const std::string& struct_name)
+{
+    std::string levels_code;
+    //blocks of one level don't depend on each other, so emitting them together lets compiler interleave them
+    for (size_t level = 1; level < levels.size(); ++level)
+    {
+        std::vector<std::shared_ptr<BaseBlock>> gain_blocks;
+        for (const auto& block_ptr: levels[level])
+        {
+            if (block_ptr->type == BlockType::GAIN && block_ptr->width == 1 && !is_function_call(*block_ptr))
+                gain_blocks.push_back(block_ptr);
+        }
+
+        bool group_gains = options.gain_group_min_size > 0 && gain_blocks.size() >= options.gain_group_min_size;
+        for (const auto& block_ptr: levels[level])
+        {
+            if (is_function_call(*block_ptr))
+            {
+                levels_code += "\t" + generate_function_call_string(subsystem_instances[block_instances[block_ptr->sid]], "_output", struct_name);
+                continue;
+            }
+            if (group_gains && block_ptr->type == BlockType::GAIN && block_ptr->width == 1)
+                continue;
+            levels_code += generate_step_method_string(block_ptr, struct_name);
+        }
+        if (group_gains)
+            levels_code += generate_gain_group_string(gain_blocks, struct_name);
+    }
+    return levels_code;
+}
+
+std::string Generator::generate_unit_delay_string(const std::shared_ptr<BaseBlock>& block_ptr, const std::string& struct_name)
+{
+    std::shared_ptr<UnitDelayBlock> ud_block_ptr = std::dynamic_pointer_cast<UnitDelayBlock>(block_ptr);
+    return vector_loop_string(ud_block_ptr->width, signal_ref(*ud_block_ptr, struct_name) + " = " +
+                              input_ref(*ud_block_ptr->input, struct_name) + ";\n");
+}
+
+std::string Generator::generate_function_call_string(const SubsystemInstance& instance, const std::string& suffix, const std::string& struct_name)
+{
+    std::string call_code = struct_name + "_" + instance.function + suffix + "(&" + struct_name + "." + instance.field;
+    for (const auto& input_ptr: instance.inputs)
+        call_code += ", " + (input_ptr->width > 1 ? field_ref(*input_ptr, struct_name) : input_ref(*input_ptr, struct_name));
+    return call_code + ");\n";
+}
+
+bool Generator::is_function_call(const BaseBlock& block)
+{
+    //in step method a whole kept subsystem instance is one node represented by its first block
+    return current_instance == nullptr && block_instances.find(block.sid) != block_instances.end();
+}
+
+std::vector<std::vector<std::shared_ptr<BaseBlock>>> Generator::schedule_levels(const std::vector<std::shared_ptr<BaseBlock>>& scope_blocks,
+                                                                                bool contract_functions)
+{
+    auto node_of = [this, contract_functions](const BaseBlock& block) { return contract_functions ? contracted_node(block) : block.sid; };
+
+    //sources (inports, constants and states) are always ready, so only operations are scheduled
+    std::unordered_map<size_t, std::shared_ptr<BaseBlock>> nodes; //node - block representing it
+    for (const auto& block_ptr: scope_blocks)
+    {
+        if (is_operation(block_ptr->type) && constant_values.find(block_ptr->sid) == constant_values.end())
+            nodes.insert({node_of(*block_ptr), blocks[node_of(*block_ptr)]});
+    }
+
+    std::unordered_map<size_t, std::vector<size_t>> next_nodes;
+    std::unordered_map<size_t, size_t> inputs_count; //node - number of unscheduled input nodes
+    for (const auto& block_ptr: scope_blocks)
+    {
+        if (nodes.find(node_of(*block_ptr)) == nodes.end() || !is_operation(block_ptr->type))
+            continue;
+        std::shared_ptr<OperationBlock> oper_block_ptr = std::dynamic_pointer_cast<OperationBlock>(block_ptr);
+        for (const auto& input_ptr: oper_block_ptr->in_ports)
+        {
+            size_t input_node = node_of(*input_ptr);
+            size_t node = node_of(*block_ptr);
+            bool is_inside_function = input_node == node && input_ptr != block_ptr.get();
+            if (is_inside_function || nodes.find(input_node) == nodes.end() || !is_operation(input_ptr->type))
+                continue;
+            auto& input_next_nodes = next_nodes[input_node];
+            if (std::find(input_next_nodes.begin(), input_next_nodes.end(), node) != input_next_nodes.end())
+                continue;
+            input_next_nodes.push_back(node);
+            inputs_count[node] += 1;
+        }
+    }
+
+    //operation reading itself directly or through other operations can't be computed, such cycles are reported with their blocks
+    std::vector<size_t> sorted_nodes;
+    for (const auto& [node, _]: nodes)
+        sorted_nodes.push_back(node);
+    std::sort(sorted_nodes.begin(), sorted_nodes.end());
+    for (const auto& component: strongly_connected_components(sorted_nodes, next_nodes))
+    {
+        size_t start = *std::min_element(component.begin(), component.end());
+        const auto& start_next_nodes = next_nodes[start];
+        if (component.size() == 1 && std::find(start_next_nodes.begin(), start_next_nodes.end(), start) == start_next_nodes.end())
+            continue;
+        std::string path_str;
+        for (size_t node: cycle_path(start, component, next_nodes))
+            path_str += (path_str.empty() ? "" : " -> ") + block_name(*nodes[node], names);
+        throw std::logic_error("Generator: algebraic loop detected, operations on a cycle have no UnitDelay between them: " + path_str);
+    }
+
+    //Kahn's algorithm, node is one level above its latest input
+    std::unordered_map<size_t, size_t> node_levels;
+    std::queue<size_t> ready_nodes;
+    for (const auto& [node, _]: nodes)
+    {
+        if (inputs_count[node] == 0)
+        {
+            ready_nodes.push(node);
+            node_levels[node] = 1;
+        }
+    }
+
+    std::vector<std::vector<std::shared_ptr<BaseBlock>>> levels(1);
+    while (!ready_nodes.empty())
+    {
+        size_t node = ready_nodes.front();
+        ready_nodes.pop();
+        size_t level = node_levels[node];
+        if (levels.size() <= level)
+            levels.resize(level + 1);
+        levels[level].push_back(nodes[node]);
+
+        for (size_t next_node: next_nodes[node])
+        {
+            node_levels[next_node] = std::max(node_levels[next_node], level + 1);
+            if (--inputs_count[next_node] == 0)
+                ready_nodes.push(next_node);
+        }
+    }
+
+    for (auto& level_blocks: levels)
+    {
+        std::sort(level_blocks.begin(), level_blocks.end(), [](const auto& lhs, const auto& rhs)
+                  { return lhs->type != rhs->type ? lhs->type < rhs->type : lhs->sid < rhs->sid; });
+    }
+    return levels;
+}
+
+size_t Generator::contracted_node(const BaseBlock& block)
+{
+    //node of a block is its own sid or, for kept subsystem instance, sid of the instance's first block
+    auto instance = block_instances.find(block.sid);
+    if (instance != block_instances.end())
+        return subsystem_instances[instance->second].blocks.front()->sid;
+    return block.sid;
+}
+
+std::set<size_t> Generator::looping_instances()
+{
+    //the same graph schedule_levels builds for step, but of all rates at once, edges between rates are left out the same way
+    std::set<size_t> nodes;
+    std::unordered_map<size_t, std::vector<size_t>> next_nodes;
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        if (!is_operation(block_ptr->type) || constant_values.find(sid) != constant_values.end())
+            continue;
+        size_t node = contracted_node(*block_ptr);
+        nodes.insert(node);
+        for (const auto& input_ptr: dynamic_cast<const OperationBlock&>(*block_ptr).in_ports)
+        {
+            size_t input_node = contracted_node(*input_ptr);
+            if (input_node == node || !is_operation(input_ptr->type) || constant_values.find(input_ptr->sid) != constant_values.end() ||
+                block_rates[input_ptr->sid] != block_rates[sid])
+                continue;
+            auto& input_next_nodes = next_nodes[input_node];
+            if (std::find(input_next_nodes.begin(), input_next_nodes.end(), node) == input_next_nodes.end())
+                input_next_nodes.push_back(node);
+        }
+    }
+
+    std::set<size_t> instances;
+    for (const auto& component: strongly_connected_components(std::vector<size_t>(nodes.begin(), nodes.end()), next_nodes))
+    {
+        if (component.size() == 1)
+            continue;
+        for (size_t node: component)
+        {
+            auto instance = block_instances.find(node);
+            if (instance != block_instances.end())
+                instances.insert(instance->second);
+        }
+    }
+    return instances;
+}
+
+void Generator::schedule_rates()
+{
+    rate_levels.clear();
+    for (size_t rate = 0; rate < rate_periods.size(); ++rate)
+        rate_levels.push_back(schedule_levels(rate_blocks(rate), true));
+}
+
+bool Generator::is_scheduled(const BaseBlock& block)
+{
+    //sources (inports, constants and states) are always ready, so only operations are scheduled
+    return is_operation(block.type) && constant_values.find(block.sid) == constant_values.end();
+}
+
+uint64_t Generator::block_fingerprint(const BaseBlock& block)
+{
+    //everything block's code and level depend on besides its inputs' own fingerprints
+    std::string description = block_parameters_string(block) + ":" + names[block.subsystem] + "/" + names[block.name] + ":" +
+                              names[block.port_name] + ":" + std::to_string(block.is_port) + ":" + std::to_string(block_rates[block.sid]);
+    for (const auto& input_ptr: block_inputs(block))
+        description.append(reinterpret_cast<const char*>(&block_keys[input_ptr->sid]), sizeof(uint64_t));
+    return fnv1a(description);
+}
+
+uint64_t Generator::block_layout_fingerprint(const BaseBlock& block, size_t level)
+{
+    //field and its place in layout, which follows levels and inputs, and ext port; values of parameters aren't there
+    std::string description = std::to_string(block.type) + ":" + std::to_string(block.width) + ":" + names[block.subsystem] + "/" +
+                              names[block.name] + ":" + names[block.port_name] + ":" + std::to_string(block.is_port) + ":" +
+                              std::to_string(constant_values.find(block.sid) != constant_values.end()) + ":" +
+                              std::to_string(block_rates[block.sid]) + ":" + std::to_string(level);
+    if (block.type == BlockType::DISCRETE_FILTER)
+    {
+        const auto& filter_block = dynamic_cast<const DiscreteFilterBlock&>(block);
+        description += ":" + std::to_string(filter_block.numerator.size()) + ":" + std::to_string(filter_block.denominator.size());
+    }
+    for (const auto& input_ptr: block_inputs(block))
+        description.append(reinterpret_cast<const char*>(&block_keys[input_ptr->sid]), sizeof(uint64_t));
+    return fnv1a(description);
+}
+
+std::unordered_set<size_t> Generator::downstream_cone(const std::unordered_set<size_t>& changed_sids)
+{
+    std::unordered_set<size_t> cone(changed_sids.begin(), changed_sids.end());
+    if (changed_sids.empty())
+        return cone;
+
+    std::unordered_map<size_t, std::vector<size_t>> next_blocks; //sid - sids of blocks reading it
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        for (const auto& input_ptr: block_inputs(*block_ptr))
+            next_blocks[input_ptr->sid].push_back(sid);
+    }
+
+    //unchanged state is still read as before by blocks after it, so cone doesn't go past it
+    std::vector<size_t> stack(changed_sids.begin(), changed_sids.end());
+    while (!stack.empty())
+    {
+        size_t sid = stack.back();
+        stack.pop_back();
+        if (blocks[sid]->type == BlockType::UNIT_DELAY && changed_sids.find(sid) == changed_sids.end())
+            continue;
+        for (size_t next_sid: next_blocks[sid])
+        {
+            if (cone.insert(next_sid).second)
+                stack.push_back(next_sid);
+        }
+    }
+    return cone;
+}
 
-namespace generator
+void Generator::schedule_cone(const std::unordered_set<size_t>& cone, std::unordered_map<size_t, size_t>& node_levels)
 {
+    //inputs outside of cone have levels already, Kahn's algorithm runs on cone's operations only
+    std::vector<size_t> cone_nodes;
+    std::unordered_map<size_t, std::vector<size_t>> next_nodes;
+    std::unordered_map<size_t, size_t> inputs_count; //node - number of unscheduled input nodes
+    for (size_t sid: cone)
+    {
+        const auto& block_ptr = blocks[sid];
+        if (!is_scheduled(*block_ptr))
+            continue;
+        cone_nodes.push_back(sid);
+        size_t& level = node_levels[sid];
+        level = 1;
+        for (const auto& input_ptr: block_inputs(*block_ptr))
+        {
+            if (!is_scheduled(*input_ptr) || block_rates[input_ptr->sid] != block_rates[sid])
+                continue;
+            if (cone.find(input_ptr->sid) != cone.end())
+            {
+                next_nodes[input_ptr->sid].push_back(sid);
+                inputs_count[sid] += 1;
+            }
+            else
+            {
+                level = std::max(level, node_levels[input_ptr->sid] + 1);
+            }
+        }
+    }
 
-Generator::Generator(const ParserResult&& blocks)
-{
-    this->blocks = std::move(blocks);
-}
+    std::queue<size_t> ready_nodes;
+    for (size_t node: cone_nodes)
+    {
+        if (inputs_count[node] == 0)
+            ready_nodes.push(node);
+    }
+    size_t scheduled_count = 0;
+    while (!ready_nodes.empty())
+    {
+        size_t node = ready_nodes.front();
+        ready_nodes.pop();
+        scheduled_count += 1;
+        for (size_t next_node: next_nodes[node])
+        {
+            node_levels[next_node] = std::max(node_levels[next_node], node_levels[node] + 1);
+            if (--inputs_count[next_node] == 0)
+                ready_nodes.push(next_node);
+        }
+    }
 
+    //operations left are on a cycle, which goes through a changed block, so it lies in cone; full scheduling reports it with its path
+    if (scheduled_count != cone_nodes.size())
+    {
+        schedule_rates();
+        throw std::logic_error("Generator: algebraic loop detected");
+    }
+}
 
-void Generator::generate_code(const std::string& struct_name, const std::string& file_name)
+void Generator::set_rate_levels(const std::unordered_map<size_t, size_t>& node_levels)
 {
-    std::ofstream fout(file_name + ".c");
-    generate_headers(fout, file_name);
-    generate_struct(fout, struct_name);
-    generate_init_method(fout, struct_name);
-    generate_step_method(fout, struct_name);
-    generate_ext_ports(fout, struct_name);
+    rate_levels.assign(rate_periods.size(), std::vector<std::vector<std::shared_ptr<BaseBlock>>>(1));
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        auto level = node_levels.find(sid);
+        if (level == node_levels.end())
+            continue;
+        auto& levels = rate_levels[block_rates[sid]];
+        if (levels.size() <= level->second)
+            levels.resize(level->second + 1);
+        levels[level->second].push_back(block_ptr);
+    }
+
+    //the same order schedule_levels gives
+    for (auto& levels: rate_levels)
+    {
+        for (auto& level_blocks: levels)
+        {
+            std::sort(level_blocks.begin(), level_blocks.end(), [](const auto& lhs, const auto& rhs)
+                      { return lhs->type != rhs->type ? lhs->type < rhs->type : lhs->sid < rhs->sid; });
+        }
+    }
 }
 
-void Generator::generate_headers(std::ofstream& fout, const std::string& file_name)
+void Generator::split_chunks()
 {
-    std::string headers_code = "";
-    headers_code += "#include \"" + file_name + "_run.h\"\n";
-    headers_code += "#include <math.h>\n";
-    fout << headers_code;
+    //chunk ends after a block whose key is a multiple of chunk size, so boundaries move with blocks rather than positions
+    //and inserting or removing a block changes only the chunk around it; chunk is named after its first block
+    chunks.clear();
+    auto add_chunks = [this](size_t rate, ChunkKind kind, const std::vector<std::shared_ptr<BaseBlock>>& chunk_blocks,
+                             const std::vector<size_t>& block_levels)
+    {
+        const char* prefixes[] = {"output_", "update_", "init_"};
+        bool is_chunk_end = true;
+        for (size_t i = 0; i < chunk_blocks.size(); ++i)
+        {
+            if (is_chunk_end)
+                chunks.push_back({prefixes[kind] + block_name(*chunk_blocks[i], names), rate, kind, {}, {}});
+            chunks.back().blocks.push_back(chunk_blocks[i]);
+            if (!block_levels.empty())
+                chunks.back().block_levels.push_back(block_levels[i]);
+            is_chunk_end = block_keys[chunk_blocks[i]->sid] % options.output_chunk_blocks == 0;
+        }
+    };
+
+    for (size_t rate = 0; rate < rate_periods.size(); ++rate)
+    {
+        std::vector<std::shared_ptr<BaseBlock>> output_blocks;
+        std::vector<size_t> output_levels;
+        for (size_t level = 0; level < rate_levels[rate].size(); ++level)
+        {
+            output_blocks.insert(output_blocks.end(), rate_levels[rate][level].begin(), rate_levels[rate][level].end());
+            output_levels.insert(output_levels.end(), rate_levels[rate][level].size(), level);
+        }
+        add_chunks(rate, OUTPUT_CHUNK, output_blocks, output_levels);
+
+        std::vector<std::shared_ptr<BaseBlock>> update_blocks;
+        for (const auto& block_ptr: rate_blocks(rate))
+        {
+            if (block_ptr->type == BlockType::UNIT_DELAY)
+                update_blocks.push_back(block_ptr);
+        }
+        add_chunks(rate, UPDATE_CHUNK, update_blocks, {});
+    }
+
+    std::vector<std::shared_ptr<BaseBlock>> init_blocks;
+    for (const auto& [_, block_ptr]: blocks)
+    {
+        if (block_ptr->type == BlockType::UNIT_DELAY || block_ptr->type == BlockType::DISCRETE_FILTER ||
+            constant_values.find(block_ptr->sid) != constant_values.end())
+            init_blocks.push_back(block_ptr);
+    }
+    add_chunks(0, INIT_CHUNK, init_blocks, {});
 }
 
-void Generator::generate_struct(std::ofstream& fout, const std::string& struct_name)
+void Generator::warn_unobserved_blocks()
 {
-    std::string struct_code = "\nstatic struct\n{\n";
+    //blocks are observed through ports, anything not reaching one is still generated but likely a wiring mistake
+    std::unordered_set<size_t> observed;
+    std::vector<std::shared_ptr<BaseBlock>> stack;
     for (const auto& [sid, block_ptr]: blocks)
     {
-        struct_code += "\tdouble " + block_ptr->name + ";\n";
+        if (block_ptr->type == BlockType::OUTPORT)
+            observed.insert(sid);
+        else if (block_ptr->is_port && observed.insert(sid).second)
+            stack.push_back(block_ptr);
     }
-    struct_code += "} " + struct_name + ";\n";
-    fout << struct_code;
+    while (!stack.empty())
+    {
+        std::shared_ptr<BaseBlock> block_ptr = stack.back();
+        stack.pop_back();
+        for (const auto& input_ptr: block_inputs(*block_ptr))
+        {
+            if (observed.insert(input_ptr->sid).second)
+                stack.push_back(input_ptr);
+        }
+    }
+
+    std::vector<std::string> unobserved_names;
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        if (observed.find(sid) == observed.end())
+            unobserved_names.push_back(block_name(*block_ptr, names));
+    }
+    std::sort(unobserved_names.begin(), unobserved_names.end());
+    for (const auto& name: unobserved_names)
+        std::cerr << "Generator: block " << name << " doesn't reach any port\n";
 }
 
-void Generator::generate_init_method(std::ofstream& fout, const std::string& struct_name)
+void Generator::assign_rates()
 {
-    std::string init_code = "\nvoid " + struct_name + "_generated_init()\n{\n";
+    rate_periods.clear();
+    block_rates.clear();
+
+    std::unordered_map<size_t, double> sample_times; //sid - sample time of block, explicit or inherited
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        if (block_ptr->sample_time > 0 && constant_values.find(sid) == constant_values.end())
+            sample_times[sid] = block_ptr->sample_time;
+    }
+
+    //blocks without any sample time, constants included, run at base rate
+    double base_sample_time = 0;
+    for (const auto& [_, sample_time]: sample_times)
+        base_sample_time = base_sample_time == 0 ? sample_time : std::min(base_sample_time, sample_time);
+
+    //sources without sample time produce base rate signals, so their consumers can't inherit a slower rate from other inputs
     for (const auto& [sid, block_ptr]: blocks)
     {
-        if (block_ptr->type == BlockType::UNIT_DELAY)
+        if (base_sample_time > 0 && block_ptr->sample_time <= 0 && constant_values.find(sid) == constant_values.end() &&
+            block_inputs(*block_ptr).empty())
+            sample_times[sid] = base_sample_time;
+    }
+
+    //inherited sample time is the fastest one of inputs, it only decreases, so repeating until nothing changes terminates
+    bool is_changed = true;
+    while (is_changed)
+    {
+        is_changed = false;
+        for (const auto& [sid, block_ptr]: blocks)
         {
-            init_code += "\t" + struct_name + "." + block_ptr->name + " = 0;\n";
+            if (block_ptr->sample_time > 0 || constant_values.find(sid) != constant_values.end())
+                continue;
+            for (const auto& input_ptr: block_inputs(*block_ptr))
+            {
+                auto input_sample_time = sample_times.find(input_ptr->sid);
+                if (input_sample_time == sample_times.end())
+                    continue;
+                auto sample_time = sample_times.find(sid);
+                if (sample_time == sample_times.end() || input_sample_time->second < sample_time->second)
+                {
+                    sample_times[sid] = input_sample_time->second;
+                    is_changed = true;
+                }
+            }
         }
     }
-    init_code += "}\n";
-    fout << init_code;
+
+    std::map<size_t, std::vector<size_t>> period_blocks; //period in base rate steps - sids
+    for (const auto& [sid, _]: blocks)
+    {
+        auto sample_time = sample_times.find(sid);
+        if (sample_time == sample_times.end())
+        {
+            period_blocks[1].push_back(sid);
+            continue;
+        }
+        double period = std::round(sample_time->second / base_sample_time);
+        if (std::fabs(period * base_sample_time - sample_time->second) > 1e-9 * sample_time->second)
+            throw std::invalid_argument("Generator: sample time " + double_literal(sample_time->second) + " of block " + block_name(*blocks[sid], names) +
+                                        " isn't a multiple of base sample time " + double_literal(base_sample_time));
+        period_blocks[static_cast<size_t>(period)].push_back(sid);
+    }
+
+    rate_periods.push_back(1);
+    for (const auto& [period, sids]: period_blocks)
+    {
+        if (period != 1)
+            rate_periods.push_back(period);
+        for (size_t sid: sids)
+            block_rates[sid] = rate_periods.size() - 1;
+    }
 }
 
-void Generator::generate_step_method(std::ofstream& fout, const std::string& struct_name)
+std::vector<size_t> Generator::rates_call_order()
 {
-    std::string method_code = "\nvoid " + struct_name + "_generated_step()\n{\n";
-
-    //searching for start block (need inport block)
-    std::shared_ptr<BaseBlock> start_block_ptr = nullptr;
+    //rate group reading outputs of another one computed in the same step runs after it, faster groups go first otherwise
+    std::vector<std::vector<size_t>> next_rates(rate_periods.size());
+    std::vector<size_t> inputs_count(rate_periods.size(), 0);
     for (const auto& [sid, block_ptr]: blocks)
     {
-        if (block_ptr->type == BlockType::INPORT)
+        if (!is_operation(block_ptr->type) || constant_values.find(sid) != constant_values.end())
+            continue;
+        for (const auto& input_ptr: block_inputs(*block_ptr))
         {
-            start_block_ptr = block_ptr;
-            break;
+            size_t input_rate = block_rates[input_ptr->sid];
+            size_t rate = block_rates[sid];
+            if (input_rate == rate || !is_operation(input_ptr->type) || constant_values.find(input_ptr->sid) != constant_values.end())
+                continue;
+            if (std::find(next_rates[input_rate].begin(), next_rates[input_rate].end(), rate) != next_rates[input_rate].end())
+                continue;
+            next_rates[input_rate].push_back(rate);
+            inputs_count[rate] += 1;
         }
     }
 
-    std::unordered_set<size_t> visited_blocks; //sids of visited blocks
-    std::shared_ptr<BaseBlock> current_block_ptr;
-    std::queue<std::shared_ptr<BaseBlock>> blocks_queue;
-    std::unordered_set<size_t> unit_delay_blocks; //sids of unit delay blocks
-    blocks_queue.push(start_block_ptr);
-
-    while (!blocks_queue.empty())
+    std::vector<size_t> order;
+    std::set<size_t> ready_rates;
+    for (size_t rate = 0; rate < rate_periods.size(); ++rate)
+    {
+        if (inputs_count[rate] == 0)
+            ready_rates.insert(rate);
+    }
+    while (!ready_rates.empty())
     {
+        size_t rate = *ready_rates.begin();
+        ready_rates.erase(ready_rates.begin());
+        order.push_back(rate);
+        for (size_t next_rate: next_rates[rate])
+        {
+            if (--inputs_count[next_rate] == 0)
+                ready_rates.insert(next_rate);
+        }
+    }
+
+    if (order.size() != rate_periods.size())
+        throw std::logic_error("Generator: rate groups read each other's outputs within one step, a UnitDelay is needed between them");
+    return order;
+}
+
+void Generator::collect_subsystem_instances()
+{
+    subsystem_instances.clear();
+    block_instances.clear();
+    block_fields.clear();
+    if (options.subsystem_function_min_blocks == 0 && !options.share_identical_subsystems)
+        return;
 
-        current_block_ptr = blocks_queue.front();
-        blocks_queue.pop();
+    //only outermost subsystems are kept, anything nested in them is inlined into their function
+    std::map<std::string, std::vector<std::shared_ptr<BaseBlock>>> top_subsystems;
+    for (const auto& [_, block_ptr]: blocks)
+    {
+        std::string subsystem = names[block_ptr->subsystem];
+        if (!subsystem.empty())
+            top_subsystems[subsystem.substr(0, subsystem.find('/'))].push_back(block_ptr);
+    }
 
-        if (visited_blocks.find(current_block_ptr->sid) != visited_blocks.end())
+    std::map<std::string, std::vector<SubsystemInstance>> identical_instances; //canonical form - instances
+    for (auto& [path, subsystem_blocks]: top_subsystems)
+    {
+        //functions are called from one rate group, so subsystems mixing rates are inlined
+        bool is_single_rate = std::all_of(subsystem_blocks.begin(), subsystem_blocks.end(), [this, &subsystem_blocks](const auto& block_ptr)
+                                          { return block_rates[block_ptr->sid] == block_rates[subsystem_blocks.front()->sid]; });
+        if (!is_single_rate)
             continue;
 
-        bool all_inputs_ready = true;
-        if (is_operation(current_block_ptr->type))
+        SubsystemInstance instance;
+        instance.field = path;
+        instance.blocks = subsystem_blocks;
+        identical_instances[canonical_form(instance.blocks, instance.inputs)].push_back(instance);
+    }
+
+    for (auto& [_, instances]: identical_instances)
+    {
+        bool is_shared = options.share_identical_subsystems && instances.size() > 1;
+        for (auto& instance: instances)
         {
-            std::shared_ptr<OperationBlock> current_oper_block = std::dynamic_pointer_cast<OperationBlock>(current_block_ptr);
-            for (const auto &[_, input_ptr] : current_oper_block->in_ports)
+            bool is_large = options.subsystem_function_min_blocks > 0 && instance.blocks.size() >= options.subsystem_function_min_blocks;
+            if (!is_shared && !is_large)
+                continue;
+
+            //shared instances use names of the first one for state type, functions and fields
+            const auto& definition = is_shared ? instances.front() : instance;
+            instance.function = definition.field;
+            instance.emits_function = &definition == &instance;
+            for (size_t i = 0; i < instance.blocks.size(); ++i)
             {
-                auto locked_input_ptr = input_ptr.lock();
-                if (visited_blocks.find(locked_input_ptr->sid) == visited_blocks.end())
-                {
-                    all_inputs_ready = false;
-                    blocks_queue.push(locked_input_ptr);
-                }
+                block_instances[instance.blocks[i]->sid] = subsystem_instances.size();
+                block_fields[instance.blocks[i]->sid] = block_name(*definition.blocks[i], names).substr(definition.field.size() + 1);
             }
+            subsystem_instances.push_back(instance);
         }
+    }
 
-        if (!all_inputs_ready)
+    //a kept instance is one node in step, so a path leaving it and coming back in is a cycle even if its blocks form none;
+    //instances on such cycles are inlined, real loops are then reported by scheduling with their blocks
+    for (std::set<size_t> looping = looping_instances(); !looping.empty(); looping = looping_instances())
+    {
+        std::vector<SubsystemInstance> kept_instances;
+        for (size_t i = 0; i < subsystem_instances.size(); ++i)
         {
-            blocks_queue.push(current_block_ptr);
-            continue;
+            if (looping.find(i) == looping.end())
+            {
+                kept_instances.push_back(subsystem_instances[i]);
+                continue;
+            }
+            for (const auto& block_ptr: subsystem_instances[i].blocks)
+                block_fields.erase(block_ptr->sid);
+            //another instance sharing the function emits it instead
+            auto sharing_instance = std::find_if(subsystem_instances.begin() + i + 1, subsystem_instances.end(), [&](const auto& instance)
+                                                 { return instance.function == subsystem_instances[i].function; });
+            if (subsystem_instances[i].emits_function && sharing_instance != subsystem_instances.end())
+                sharing_instance->emits_function = true;
         }
-
-        if (is_operation(current_block_ptr->type))
+        subsystem_instances = kept_instances;
+        block_instances.clear();
+        for (size_t i = 0; i < subsystem_instances.size(); ++i)
         {
-            method_code += generate_step_method_string(current_block_ptr, struct_name);
+            for (const auto& block_ptr: subsystem_instances[i].blocks)
+                block_instances[block_ptr->sid] = i;
         }
-        else if (current_block_ptr->type == BlockType::UNIT_DELAY)
+    }
+}
+
+std::string Generator::canonical_form(std::vector<std::shared_ptr<BaseBlock>>& subsystem_blocks, std::vector<std::shared_ptr<BaseBlock>>& inputs)
+{
+    std::unordered_map<size_t, size_t> block_indices; //sid - index in subsystem_blocks
+    for (size_t i = 0; i < subsystem_blocks.size(); ++i)
+        block_indices[subsystem_blocks[i]->sid] = i;
+
+    auto external_label = [this](const BaseBlock& input_block)
+    {
+        auto constant_value = constant_values.find(input_block.sid);
+        if (constant_value != constant_values.end() && input_block.width == 1)
+            return "c" + double_literal(constant_value->second[0]);
+        return "x" + std::to_string(input_block.width);
+    };
+
+    //labels are refined with labels of inputs until they stop splitting, so equal labels mean equal upstream structure
+    std::vector<std::string> labels;
+    for (const auto& block_ptr: subsystem_blocks)
+        labels.push_back(block_parameters_string(*block_ptr));
+    size_t distinct_count = 0;
+    for (size_t round = 0; round < subsystem_blocks.size(); ++round)
+    {
+        std::vector<std::string> next_labels;
+        for (const auto& block_ptr: subsystem_blocks)
         {
-            unit_delay_blocks.insert(current_block_ptr->sid);
+            std::string label = labels[block_indices[block_ptr->sid]] + "(";
+            for (const auto& input_ptr: block_inputs(*block_ptr))
+            {
+                auto input_index = block_indices.find(input_ptr->sid);
+                label += (input_index != block_indices.end() ? labels[input_index->second] : external_label(*input_ptr)) + ",";
+            }
+            next_labels.push_back(std::to_string(fnv1a(label + ")")));
         }
+        std::vector<std::string> sorted_labels = next_labels;
+        std::sort(sorted_labels.begin(), sorted_labels.end());
+        size_t next_distinct_count = std::unique(sorted_labels.begin(), sorted_labels.end()) - sorted_labels.begin();
+        labels = next_labels;
+        if (next_distinct_count == distinct_count)
+            break;
+        distinct_count = next_distinct_count;
+    }
+
+    //ties between equal labels are broken by local name, which matches for copies of one library block
+    std::vector<size_t> order(subsystem_blocks.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs)
+              { return labels[lhs] != labels[rhs] ? labels[lhs] < labels[rhs] :
+                       std::strcmp(names[subsystem_blocks[lhs]->name], names[subsystem_blocks[rhs]->name]) < 0; });
+    std::vector<std::shared_ptr<BaseBlock>> ordered_blocks;
+    for (size_t i: order)
+        ordered_blocks.push_back(subsystem_blocks[i]);
+    subsystem_blocks = ordered_blocks;
+    for (size_t i = 0; i < subsystem_blocks.size(); ++i)
+        block_indices[subsystem_blocks[i]->sid] = i;
 
-        visited_blocks.insert(current_block_ptr->sid);
-        for (const auto& next_block: current_block_ptr->next_blocks)
+    //full description with wiring by canonical indices, equal strings mean identical subsystems
+    std::string form;
+    inputs.clear();
+    for (const auto& block_ptr: subsystem_blocks)
+    {
+        form += block_parameters_string(*block_ptr) + "(";
+        for (const auto& input_ptr: block_inputs(*block_ptr))
         {
-            if (visited_blocks.find(next_block.lock()->sid) == visited_blocks.end())
+            auto input_index = block_indices.find(input_ptr->sid);
+            if (input_index != block_indices.end())
+            {
+                form += "b" + std::to_string(input_index->second) + ",";
+                continue;
+            }
+            std::string label = external_label(*input_ptr);
+            if (label[0] == 'x')
             {
-                blocks_queue.push(next_block.lock());
+                auto input = std::find(inputs.begin(), inputs.end(), input_ptr);
+                label += "i" + std::to_string(input - inputs.begin());
+                if (input == inputs.end())
+                    inputs.push_back(input_ptr);
             }
+            form += label + ",";
         }
+        form += ");";
+    }
+    return form;
+}
+
+std::string Generator::block_parameters_string(const BaseBlock& block)
+{
+    std::string parameters = std::to_string(block.type) + ":" + std::to_string(block.width);
+    auto add_values = [&parameters](const std::vector<double>& values)
+    {
+        parameters += "[";
+        for (double value: values)
+            parameters += double_literal(value) + " ";
+        parameters += "]";
+    };
+
+    auto constant_value = constant_values.find(block.sid);
+    if (constant_value != constant_values.end())
+        add_values(constant_value->second);
+    if (is_operation(block.type))
+    {
+        const auto& oper_block = dynamic_cast<const OperationBlock&>(block);
+        parameters += ":" + signs_string(oper_block);
+        if (block.type == BlockType::GAIN)
+            parameters += ":" + double_literal(oper_block.gain);
+    }
+    if (block.type == BlockType::DISCRETE_FILTER)
+    {
+        const auto& filter_block = dynamic_cast<const DiscreteFilterBlock&>(block);
+        add_values(filter_block.numerator);
+        add_values(filter_block.denominator);
     }
+    else if (block.type == BlockType::LOOKUP)
+    {
+        const auto& lookup_block = dynamic_cast<const LookupBlock&>(block);
+        for (const auto& breakpoints: lookup_block.breakpoints)
+            add_values(breakpoints);
+        add_values(lookup_block.table);
+    }
+    else if (block.type == BlockType::SATURATION)
+    {
+        const auto& saturation_block = dynamic_cast<const SaturationBlock&>(block);
+        add_values({saturation_block.lower_limit, saturation_block.upper_limit});
+    }
+    else if (block.type == BlockType::SWITCH)
+    {
+        const auto& switch_block = dynamic_cast<const SwitchBlock&>(block);
+        parameters += ":" + std::to_string(switch_block.criteria) + ":" + double_literal(switch_block.threshold);
+    }
+    return parameters;
+}
 
-    for (const auto &ud_block_sid : unit_delay_blocks)
+std::string Generator::field_ref(const BaseBlock& block, const std::string& struct_name)
+{
+    auto instance_index = block_instances.find(block.sid);
+    if (instance_index == block_instances.end())
     {
-        std::shared_ptr<UnitDelayBlock> ud_block_ptr = std::dynamic_pointer_cast<UnitDelayBlock>(blocks[ud_block_sid]);
-        method_code += "\t" + struct_name + "." + ud_block_ptr->name + " = " + struct_name + ".";
-        method_code += ud_block_ptr->input.lock()->name + ";\n";
+        if (current_instance != nullptr)
+        {
+            auto input = std::find_if(current_instance->inputs.begin(), current_instance->inputs.end(), [&block](const auto& input_ptr)
+                                      { return input_ptr.get() == &block; });
+            return "in" + std::to_string(input - current_instance->inputs.begin());
+        }
+        //globals of chunked output get a prefix no generated function name has
+        return struct_name + (options.output_chunk_blocks > 0 ? "_s_" : ".") + block_name(block, names);
     }
 
-    method_code += "}\n";
-    fout << method_code;
+    const auto& instance = subsystem_instances[instance_index->second];
+    if (current_instance == &instance)
+        return "s->" + block_fields[block.sid];
+    return struct_name + "." + instance.field + "." + block_fields[block.sid];
+}
+
+std::string Generator::signal_ref(const BaseBlock& block, const std::string& struct_name, const std::string& index)
+{
+    //reference to element of block's signal; scalar signals are broadcast to every element
+    std::string ref = field_ref(block, struct_name);
+    if (block.width > 1)
+        ref += "[" + index + "]";
+    return ref;
 }
 
 std::string Generator::generate_step_method_string(const std::shared_ptr<BaseBlock>& block_ptr, const std::string& struct_name)
 {
-    std::string method_string_code = "\t" + struct_name + "." + block_ptr->name + " = ";
+    if (block_ptr->type == BlockType::DISCRETE_FILTER)
+        return generate_filter_string(block_ptr, struct_name);
+    if (block_ptr->type == BlockType::LOOKUP)
+        return generate_lookup_string(block_ptr, struct_name);
+
+    std::string method_string_code = signal_ref(*block_ptr, struct_name) + " = ";
     std::shared_ptr<OperationBlock> current_oper_block = std::dynamic_pointer_cast<OperationBlock>(block_ptr);
     const auto &in_ports = current_oper_block->in_ports;
     if (current_oper_block->type == BlockType::SUM)
     {
-        bool has_signs = current_oper_block->inputs != "";
-        bool is_first = true;
-        for (const auto &[port_num, input_block_ptr] : in_ports)
+        for (size_t port = 0; port < in_ports.size(); ++port)
         {
-            if (!is_first || has_signs)
-            {
-                if (has_signs)
-                    method_string_code += " " + std::string(1, current_oper_block->inputs[port_num - 1]) + " ";
-                else
-                    method_string_code += " + ";
-                is_first = false;
-            }
-            method_string_code += struct_name + "." + input_block_ptr.lock()->name;
-            is_first = false;
+            bool is_subtraction = in_ports.is_inverted(port);
+            if (port == 0)
+                method_string_code += is_subtraction ? "-" : "";
+            else
+                method_string_code += is_subtraction ? " - " : " + ";
+            method_string_code += input_ref(*in_ports[port], struct_name);
         }
     }
     else if (current_oper_block->type == BlockType::GAIN)
     {
-        bool is_first = true;
-        for (const auto &[port_num, input_block_ptr] : in_ports)
+        method_string_code += input_ref(*in_ports[0], struct_name) + " * " + double_literal(current_oper_block->gain);
+    }
+    else if (current_oper_block->type == BlockType::PRODUCT)
+    {
+        auto inputs = ordered_inputs(*current_oper_block);
+        for (size_t i = 0; i < inputs.size(); ++i)
         {
-            method_string_code += struct_name + "." + input_block_ptr.lock()->name + " * " + std::to_string(current_oper_block->gain);
+            bool is_division = in_ports.is_inverted(i);
+            if (i == 0)
+                method_string_code += is_division ? "1.0 / " : "";
+            else
+                method_string_code += is_division ? " / " : " * ";
+            method_string_code += input_ref(*inputs[i], struct_name);
         }
     }
+    else if (current_oper_block->type == BlockType::SATURATION)
+    {
+        //fmin/fmax compile to minsd/maxsd without branches
+        std::shared_ptr<SaturationBlock> saturation_block_ptr = std::dynamic_pointer_cast<SaturationBlock>(block_ptr);
+        method_string_code += "fmin(fmax(" + input_ref(*in_ports[0], struct_name) + ", " +
+                              double_literal(saturation_block_ptr->lower_limit) + "), " + double_literal(saturation_block_ptr->upper_limit) + ")";
+    }
+    else if (current_oper_block->type == BlockType::SWITCH)
+    {
+        //both data inputs are already computed, so select compiles to cmov/blend instead of a jump
+        std::shared_ptr<SwitchBlock> switch_block_ptr = std::dynamic_pointer_cast<SwitchBlock>(block_ptr);
+        auto inputs = ordered_inputs(*current_oper_block);
+        if (inputs.size() != 3)
+            throw std::logic_error("Generator: switch block " + block_name(*block_ptr, names) + " must have 3 inputs");
+        std::string control = input_ref(*inputs[1], struct_name);
+        if (switch_block_ptr->criteria == SwitchCriteria::GREATER_OR_EQUAL)
+            control += " >= " + double_literal(switch_block_ptr->threshold);
+        else if (switch_block_ptr->criteria == SwitchCriteria::GREATER)
+            control += " > " + double_literal(switch_block_ptr->threshold);
+        else
+            control += " != 0";
+        method_string_code += "(" + control + ") ? " + input_ref(*inputs[0], struct_name) + " : " + input_ref(*inputs[2], struct_name);
+    }
     method_string_code += ";\n";
-    return method_string_code;
+    return vector_loop_string(block_ptr->width, method_string_code);
+}
+
+std::string Generator::generate_filter_string(const std::shared_ptr<BaseBlock>& block_ptr, const std::string& struct_name)
+{
+    std::shared_ptr<DiscreteFilterBlock> filter_block_ptr = std::dynamic_pointer_cast<DiscreteFilterBlock>(block_ptr);
+    std::string output = field_ref(*block_ptr, struct_name);
+    std::string x_size = std::to_string(filter_block_ptr->numerator.size());
+    std::string x_pos = output + "_x_pos";
+    std::string input = input_ref(*filter_block_ptr->in_ports[0], struct_name);
+
+    //newest sample goes to the front of the window: window[k] = x[n - k]
+    std::string filter_code = "\t{\n" + coefficients_array("b", filter_block_ptr->numerator, 0);
+    if (filter_block_ptr->denominator.size() > 1)
+        filter_code += coefficients_array("a", filter_block_ptr->denominator, 1);
+    filter_code += "\t\t" + x_pos + " = " + x_pos + " == 0 ? " + x_size + " - 1 : " + x_pos + " - 1;\n";
+    filter_code += "\t\t" + output + "_x[" + x_pos + "] = " + output + "_x[" + x_pos + " + " + x_size + "] = " + input + ";\n";
+    filter_code += "\t\t" + output + " = nwocg_dot(b, &" + output + "_x[" + x_pos + "], " + x_size + ");\n";
+
+    if (filter_block_ptr->denominator.size() > 1)
+    {
+        //y window holds previous outputs: window[k] = y[n - 1 - k]
+        std::string y_size = std::to_string(filter_block_ptr->denominator.size() - 1);
+        std::string y_pos = output + "_y_pos";
+        filter_code += "\t\t" + output + " -= nwocg_dot(a, &" + output + "_y[" + y_pos + "], " + y_size + ");\n";
+        filter_code += "\t\t" + y_pos + " = " + y_pos + " == 0 ? " + y_size + " - 1 : " + y_pos + " - 1;\n";
+        filter_code += "\t\t" + output + "_y[" + y_pos + "] = " + output + "_y[" + y_pos + " + " + y_size + "] = " + output + ";\n";
+    }
+    filter_code += "\t}\n";
+    return filter_code;
+}
+
+std::string Generator::generate_lookup_string(const std::shared_ptr<BaseBlock>& block_ptr, const std::string& struct_name)
+{
+    std::shared_ptr<LookupBlock> lookup_block_ptr = std::dynamic_pointer_cast<LookupBlock>(block_ptr);
+    const auto& breakpoints = lookup_block_ptr->breakpoints;
+    std::string lookup_code = "\t{\n" + coefficients_array("table", lookup_block_ptr->table, 0);
+
+    //segment index i<d> and fraction f<d> for each dimension; fraction isn't clamped, so ends extrapolate linearly
+    for (size_t dim = 0; dim < breakpoints.size(); ++dim)
+    {
+        std::string d = std::to_string(dim + 1);
+        std::string n = std::to_string(breakpoints[dim].size());
+        std::string input = input_ref(*lookup_block_ptr->in_ports[dim], struct_name);
+        if (is_uniform(breakpoints[dim]))
+        {
+            double step = (breakpoints[dim].back() - breakpoints[dim].front()) / (breakpoints[dim].size() - 1);
+            lookup_code += "\t\tconst double t" + d + " = (" + input + " - " + double_literal(breakpoints[dim].front()) + ") * " +
+                           double_literal(1.0 / step) + ";\n";
+            lookup_code += "\t\tconst double c" + d + " = fmin(fmax(floor(t" + d + "), 0), " + n + " - 2);\n";
+            lookup_code += "\t\tconst int i" + d + " = (int)c" + d + ";\n";
+            lookup_code += "\t\tconst double f" + d + " = t" + d + " - c" + d + ";\n";
+        }
+        else
+        {
+            lookup_code += coefficients_array("bp" + d, breakpoints[dim], 0);
+            lookup_code += "\t\tconst int i" + d + " = nwocg_bsearch(bp" + d + ", " + n + ", " + input + ");\n";
+            lookup_code += "\t\tconst double f" + d + " = (" + input + " - bp" + d + "[i" + d + "]) / (bp" + d + "[i" + d +
+                           " + 1] - bp" + d + "[i" + d + "]);\n";
+        }
+    }
+
+    std::string output = field_ref(*block_ptr, struct_name);
+    if (breakpoints.size() == 1)
+    {
+        lookup_code += "\t\t" + output + " = table[i1] + f1 * (table[i1 + 1] - table[i1]);\n";
+    }
+    else
+    {
+        std::string n2 = std::to_string(breakpoints[1].size());
+        lookup_code += "\t\tconst double* row0 = &table[i1 * " + n2 + " + i2];\n";
+        lookup_code += "\t\tconst double* row1 = row0 + " + n2 + ";\n";
+        lookup_code += "\t\tconst double y0 = row0[0] + f2 * (row0[1] - row0[0]);\n";
+        lookup_code += "\t\tconst double y1 = row1[0] + f2 * (row1[1] - row1[0]);\n";
+        lookup_code += "\t\t" + output + " = y0 + f1 * (y1 - y0);\n";
+    }
+    lookup_code += "\t}\n";
+    return lookup_code;
 }
 
-void Generator::generate_ext_ports(std::ofstream& fout, const std::string& struct_name)
+std::string Generator::input_ref(const BaseBlock& input_block, const std::string& struct_name, const std::string& index)
+{
+    //scalar constants are substituted as literals, so compiler can fold them further
+    auto constant_value = constant_values.find(input_block.sid);
+    if (constant_value != constant_values.end() && input_block.width == 1)
+    {
+        double value = constant_value->second[0];
+        return value < 0 ? "(" + double_literal(value) + ")" : double_literal(value);
+    }
+    return signal_ref(input_block, struct_name, index);
+}
+
+std::vector<std::shared_ptr<BaseBlock>> Generator::ordered_inputs(const OperationBlock& oper_block)
+{
+    std::vector<std::shared_ptr<BaseBlock>> inputs;
+    inputs.reserve(oper_block.in_ports.size());
+    for (BaseBlock* input_ptr: oper_block.in_ports)
+        inputs.push_back(std::shared_ptr<BaseBlock>(arena, input_ptr));
+    return inputs;
+}
+
+std::vector<std::shared_ptr<BaseBlock>> Generator::block_inputs(const BaseBlock& block)
+{
+    if (is_operation(block.type))
+        return ordered_inputs(dynamic_cast<const OperationBlock&>(block));
+    if (block.type == BlockType::UNIT_DELAY)
+        return std::vector<std::shared_ptr<BaseBlock>>{std::shared_ptr<BaseBlock>(arena, dynamic_cast<const UnitDelayBlock&>(block).input)};
+    return std::vector<std::shared_ptr<BaseBlock>>();
+}
+
+void Generator::fold_constants()
+{
+    constant_values.clear();
+    for (const auto& [sid, block_ptr]: blocks)
+    {
+        if (block_ptr->type == BlockType::CONSTANT)
+            constant_values[sid] = std::dynamic_pointer_cast<ConstantBlock>(block_ptr)->value;
+    }
+
+    //stateless operations with only constant inputs are computed here instead of every step
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (const auto& [sid, block_ptr]: blocks)
+        {
+            if (constant_values.find(sid) != constant_values.end())
+                continue;
+            if (block_ptr->type != BlockType::SUM && block_ptr->type != BlockType::GAIN && block_ptr->type != BlockType::PRODUCT &&
+                block_ptr->type != BlockType::SATURATION && block_ptr->type != BlockType::SWITCH)
+                continue;
+
+            std::shared_ptr<OperationBlock> oper_block_ptr = std::dynamic_pointer_cast<OperationBlock>(block_ptr);
+            auto inputs = ordered_inputs(*oper_block_ptr);
+            bool all_constant = !inputs.empty();
+            for (const auto& input_ptr: inputs)
+                all_constant = all_constant && constant_values.find(input_ptr->sid) != constant_values.end();
+            if (!all_constant)
+                continue;
+
+            std::vector<double> value(block_ptr->width);
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                std::vector<double> input_values;
+                for (const auto& input_ptr: inputs)
+                {
+                    const auto& input_value = constant_values[input_ptr->sid];
+                    input_values.push_back(input_value.size() == 1 ? input_value[0] : input_value[i]);
+                }
+                value[i] = evaluate_operation(*oper_block_ptr, input_values);
+            }
+            constant_values[sid] = value;
+            changed = true;
+        }
+    }
+}
+
+double Generator::evaluate_operation(const OperationBlock& oper_block, const std::vector<double>& input_values)
+{
+    const auto& in_ports = oper_block.in_ports;
+    double result = 0;
+    if (oper_block.type == BlockType::SUM)
+    {
+        for (size_t i = 0; i < input_values.size(); ++i)
+            result += in_ports.is_inverted(i) ? -input_values[i] : input_values[i];
+    }
+    else if (oper_block.type == BlockType::GAIN)
+    {
+        result = input_values[0] * oper_block.gain;
+    }
+    else if (oper_block.type == BlockType::PRODUCT)
+    {
+        result = 1;
+        for (size_t i = 0; i < input_values.size(); ++i)
+            result = in_ports.is_inverted(i) ? result / input_values[i] : result * input_values[i];
+    }
+    else if (oper_block.type == BlockType::SATURATION)
+    {
+        const auto& saturation_block = dynamic_cast<const SaturationBlock&>(oper_block);
+        result = std::fmin(std::fmax(input_values[0], saturation_block.lower_limit), saturation_block.upper_limit);
+    }
+    else if (oper_block.type == BlockType::SWITCH)
+    {
+        const auto& switch_block = dynamic_cast<const SwitchBlock&>(oper_block);
+        bool pass_first = false;
+        if (switch_block.criteria == SwitchCriteria::GREATER_OR_EQUAL)
+            pass_first = input_values[1] >= switch_block.threshold;
+        else if (switch_block.criteria == SwitchCriteria::GREATER)
+            pass_first = input_values[1] > switch_block.threshold;
+        else
+            pass_first = input_values[1] != 0;
+        result = pass_first ? input_values[0] : input_values[2];
+    }
+    return result;
+}
+
+std::string Generator::vector_loop_string(size_t width, const std::string& statement)
+{
+    if (width <= 1)
+        return "\t" + statement;
+    //plain counted loop over aligned arrays, compilers vectorize it without intrinsics
+    std::string loop_code;
+    if (options.simd_pragmas)
+        loop_code += "\t#pragma omp simd\n";
+    loop_code += "\tfor (int i = 0; i < " + std::to_string(width) + "; ++i)\n\t\t" + statement;
+    return loop_code;
+}
+
+bool Generator::has_block_type(BlockType type)
+{
+    for (const auto& [_, block_ptr]: blocks)
+    {
+        if (block_ptr->type == type)
+            return true;
+    }
+    return false;
+}
+
+bool Generator::has_vector_signals()
+{
+    for (const auto& [_, block_ptr]: blocks)
+    {
+        if (block_ptr->width > 1)
+            return true;
+    }
+    return false;
+}
+
+std::string Generator::generate_gain_group_string(const std::vector<std::shared_ptr<BaseBlock>>& gain_blocks, const std::string& struct_name)
+{
+    std::string count = std::to_string(gain_blocks.size());
+    std::string gains_code = "\t{\n\t\tstatic const double gains[" + count + "] = { ";
+    std::string inputs_code = "\t\tconst double in[" + count + "] = { ";
+    std::string outputs_code;
+    for (size_t i = 0; i < gain_blocks.size(); ++i)
+    {
+        std::shared_ptr<OperationBlock> gain_block = std::dynamic_pointer_cast<OperationBlock>(gain_blocks[i]);
+        std::string separator = i + 1 < gain_blocks.size() ? ", " : " ";
+        gains_code += double_literal(gain_block->gain) + separator;
+        inputs_code += input_ref(*gain_block->in_ports[0], struct_name) + separator;
+        outputs_code += "\t\t" + field_ref(*gain_block, struct_name) + " = out[" + std::to_string(i) + "];\n";
+    }
+    std::string group_code = gains_code + "};\n" + inputs_code + "};\n";
+    group_code += "\t\tdouble out[" + count + "];\n";
+    group_code += "\t\tfor (int i = 0; i < " + count + "; ++i)\n\t\t\tout[i] = in[i] * gains[i];\n";
+    group_code += outputs_code + "\t}\n";
+    return group_code;
+}
+
+void Generator::generate_ext_ports(std::ostream& fout, const std::string& struct_name)
 {
     std::string ports_code = "\nstatic const " + struct_name +"_ExtPort\next_ports[] =\n{\n";
     size_t ports_count = 0;
@@ -180,7 +1881,7 @@ void Generator::generate_ext_ports(std::ofstream& fout, const std::string& struc
         if (block_ptr->is_port)
         {
             uint8_t port_code = block_ptr->type == BlockType::INPORT ? 1 : 0;
-            ports_code += "\t{ \"" + block_ptr->port_name + "\", &" + struct_name + "." + block_ptr->name + ", " + 
+            ports_code += "\t{ \"" + std::string(names[block_ptr->port_name]) + "\", &" + signal_ref(*block_ptr, struct_name, "0") + ", " + 
                           std::to_string(port_code) + " },\n";
             ports_count += 1;
         }
@@ -200,5 +1901,15 @@ void Generator::generate_ext_ports(std::ofstream& fout, const std::string& struc
     fout << ports_code;
 }
 
+std::string Generator::signs_string(const OperationBlock& oper_block)
+{
+    //operators of declared ports like "+-" or "*/", empty if any number of ports is accepted
+    std::string signs;
+    char sign = oper_block.type == BlockType::PRODUCT ? '*' : '+';
+    char inverted_sign = oper_block.type == BlockType::PRODUCT ? '/' : '-';
+    for (size_t port = 0; port < oper_block.in_ports.declared; ++port)
+        signs += oper_block.in_ports.is_inverted(port) ? inverted_sign : sign;
+    return signs;
+}
 
 }
\ No newline at end of file
@@ -1,10 +1,45 @@
 #include <parser.h>
 #include <generator.h>
+#include <watcher.h>
 
 int main(int argc, char** argv)
 {
-    generator::Parser parser("/home/sklochkov/ritm-test/data/scheme.xml");
-    generator::Generator code_generator(parser.parse());
+    //usage: RITM-TEST [scheme.xml] [--watch] [--chunk-blocks N]
+    //--chunk-blocks splits code into files of about N blocks and on later runs rewrites only files of changed blocks
+    std::string model_path = "/home/sklochkov/ritm-test/data/scheme.xml";
+    bool is_watch_mode = false;
+    bool has_chunk_blocks = false;
+    generator::GeneratorOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--watch")
+        {
+            is_watch_mode = true;
+        }
+        else if (arg == "--chunk-blocks" && i + 1 < argc)
+        {
+            options.output_chunk_blocks = std::stoul(argv[++i]);
+            has_chunk_blocks = true;
+        }
+        else
+        {
+            model_path = arg;
+        }
+    }
+
+    if (is_watch_mode)
+    {
+        //a save mostly changes a few blocks, so watcher regenerates chunks unless told to write one file with "--chunk-blocks 0"
+        if (!has_chunk_blocks)
+            options.output_chunk_blocks = 1000;
+        generator::Watcher watcher(model_path, "nwocg", options);
+        watcher.run();
+        return 0;
+    }
+
+    generator::Parser parser(model_path);
+    generator::Generator code_generator(parser.parse(), options);
     code_generator.generate_code();
     return 0;
-}
\ No newline at end of file
+}
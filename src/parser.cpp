@@ -1,21 +1,75 @@
 #include "parser.h"
 #include <iostream>
 #include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <set>
+#include <thread>
 
 namespace generator
 {
     namespace
     {
         namespace xml = tinyxml2;
-    }
 
-    Parser::Parser(const std::string file_path)
-    {
-        if (!doc.LoadFile(file_path.c_str()) == xml::XMLError::XML_SUCCESS)
+        const char* const block_attributes[] = {"Name", "SID", "BlockType"}; //read in one walk over block's attributes
+        const char* const layout_params[] = {"Position", "IconShape", "Points"}; //only draw the diagram, nothing reads them
+
+        //layout parameters are most of the bytes of an export, they are skipped without building nodes
+        bool keep_element(const xml::XMLElement& element, void*)
+        {
+            if (std::strcmp(element.Name(), "P") != 0)
+                return true;
+            const char* name = element.Attribute("Name");
+            return !name || std::none_of(std::begin(layout_params), std::end(layout_params),
+                                         [name](const char* param) { return std::strcmp(name, param) == 0; });
+        }
+
+        //number is the whole value, so expressions like "3*Kp" aren't silently cut to their first number
+        bool is_whole_value(const char* end)
+        {
+            return end && end[std::strspn(end, " \t\r\n")] == '\0';
+        }
+
+        //numeric values are read in place, locale independent; what names the value in errors
+        double number_value(const char* value_str, const std::string& what)
         {
-            std::cerr << "Read xml file error\n";
-            std::abort();
+            double value;
+            if (!is_whole_value(xml::XMLUtil::ReadDouble(value_str, &value)))
+                throw std::invalid_argument("Parser: " + what + " isn't a number: " + value_str);
+            return value;
         }
+
+        size_t count_value(const char* value_str, const std::string& what)
+        {
+            uint64_t value;
+            if (!is_whole_value(xml::XMLUtil::ReadUnsigned64(value_str, &value)))
+                throw std::invalid_argument("Parser: " + what + " isn't a non-negative integer: " + value_str);
+            return value;
+        }
+    }
+
+    Parser::Parser(const std::string file_path, int parse_threads)
+    {
+        //models have thousands of nodes, bigger pool blocks mean fewer allocations
+        doc.SetPoolBlockSize(64 * 1024);
+        doc.SetRetainCapacity(true);
+        //some exports put dozens of attributes on each block, interned names keep lookups cheap there
+        doc.SetInternNames(true);
+        //block names end up in the generated source, so broken encodings are rejected on load
+        doc.SetValidateUTF8(true);
+        //big exports are cut into chunks parsed on all cores, small ones stay on this thread
+        doc.SetParseThreads(parse_threads > 0 ? parse_threads : static_cast<int>(std::thread::hardware_concurrency()));
+        doc.SetElementFilter(keep_element);
+        load(file_path);
+    }
+
+    void Parser::load(const std::string& file_path)
+    {
+        if (doc.LoadFile(file_path.c_str()) != xml::XMLError::XML_SUCCESS)
+            throw std::runtime_error("Parser: can't read xml file " + file_path + ": " + doc.ErrorStr());
     }
 
     ParserResult Parser::parse()
@@ -27,23 +81,57 @@ namespace generator
             return ParserResult();
         }
 
-        ParserResult parser_res = parse_blocks(root);
+        connections.clear();
+        subsystems.clear();
+        nested_blocks.clear();
+        arena = std::make_shared<BlockArena>();
+        names = NameTable();
 
-        parse_lines(parser_res, root);
-        
+        SystemBlocks system_blocks = parse_system(root, "");
+
+        flatten_subsystems(system_blocks);
+
+        check_ports(system_blocks);
+
+        propagate_widths(system_blocks);
+
+        //wiring state and subsystem scaffolding aren't needed after flattening, only blocks stay alive
+        std::vector<Connection>().swap(connections);
+        std::vector<std::shared_ptr<SubSystemBlock>>().swap(subsystems);
+        std::vector<std::shared_ptr<BaseBlock>>().swap(nested_blocks);
+
+        ParserResult parser_res;
+        parser_res.blocks.reserve(system_blocks.size());
+        for (const auto& [_, block_ptr]: system_blocks)
+            parser_res.blocks.push_back(block_ptr.get());
+        std::sort(parser_res.blocks.begin(), parser_res.blocks.end(), [](const BaseBlock* lhs, const BaseBlock* rhs)
+                  { return lhs->sid < rhs->sid; });
+        names.shrink_to_fit();
+        parser_res.names = std::move(names);
+        parser_res.arena = std::move(arena);
         return parser_res;
     }
 
-    ParserResult Parser::parse_blocks(tinyxml2::XMLElement *root_xml)
+    Parser::SystemBlocks Parser::parse_system(tinyxml2::XMLElement *system_xml, const std::string& scope)
     {
-        ParserResult parser_res;
+        //SIDs are scoped by system, so lines are resolved with blocks of this system only
+        SystemBlocks system_blocks = parse_blocks(system_xml, scope);
+        parse_lines(system_blocks, system_xml);
+        return system_blocks;
+    }
+
+    Parser::SystemBlocks Parser::parse_blocks(tinyxml2::XMLElement *root_xml, const std::string& scope)
+    {
+        SystemBlocks parser_res;
         for (xml::XMLElement *block_xml = root_xml->FirstChildElement("Block"); block_xml != nullptr; block_xml = block_xml->NextSiblingElement("Block"))
         {
             std::shared_ptr<BaseBlock> block_ptr;
             BlockType block_type;
-            const char *name = block_xml->Attribute("Name");
-            const char *sid = block_xml->Attribute("SID");
-            const char *block_type_str = block_xml->Attribute("BlockType");
+            const char *attributes[3];
+            block_xml->FindAttributes(block_attributes, attributes, 3);
+            const char *name = attributes[0];
+            const char *sid = attributes[1];
+            const char *block_type_str = attributes[2];
             if (!is_block_correct(name, sid, block_type_str))
             {
                 throw std::invalid_argument("Parser: invalid block (no params)");
@@ -58,23 +146,116 @@ namespace generator
                 throw e;
             }
 
-            if (is_operation(block_type))
-            {
-                block_ptr = std::make_shared<OperationBlock>();
-            }
-            else if (block_type == BlockType::UNIT_DELAY)
+            //name and subsystem path are interned apart, so names repeated in every copy of a subsystem are stored once;
+            //together they stay unique after flattening
+            std::string local_name = name;
+            local_name.erase(std::remove_if(local_name.begin(), local_name.end(), [](unsigned char c)
+                                 { return std::isspace(c); }), local_name.end());
+            block_ptr = create_block(block_type, scope);
+            block_ptr->subsystem = names.intern(scope);
+
+            block_ptr = parse_block(block_ptr, block_xml, local_name, count_value(sid, "SID"), block_type);
+            if (block_type == BlockType::SUBSYSTEM)
+                parse_subsystem(block_ptr, block_xml, scope.empty() ? local_name : scope + "/" + local_name);
+
+            if (parser_res.find(block_ptr->sid) != parser_res.end())
+                throw std::invalid_argument("Parser: duplicated sid = " + std::to_string(block_ptr->sid));
+            parser_res.insert({block_ptr->sid, block_ptr});
+        }
+        return parser_res;
+    }
+
+    std::shared_ptr<BaseBlock> Parser::create_block(BlockType block_type, const std::string& scope)
+    {
+        //subsystems and their inner ports are gone after flattening, only blocks kept in the result go to the arena
+        if (block_type == BlockType::SUBSYSTEM)
+            return std::make_shared<SubSystemBlock>();
+        if (!scope.empty() && (block_type == BlockType::INPORT || block_type == BlockType::OUTPORT))
+            return std::make_shared<BaseBlock>();
+
+        auto arena_block = [this](BaseBlock& block) { return std::shared_ptr<BaseBlock>(arena, &block); };
+        if (block_type == BlockType::DISCRETE_FILTER)
+        {
+            return arena_block(arena->create<DiscreteFilterBlock>());
+        }
+        else if (block_type == BlockType::LOOKUP)
+        {
+            return arena_block(arena->create<LookupBlock>());
+        }
+        else if (block_type == BlockType::SATURATION)
+        {
+            return arena_block(arena->create<SaturationBlock>());
+        }
+        else if (block_type == BlockType::SWITCH)
+        {
+            return arena_block(arena->create<SwitchBlock>());
+        }
+        else if (block_type == BlockType::CONSTANT)
+        {
+            return arena_block(arena->create<ConstantBlock>());
+        }
+        else if (is_operation(block_type))
+        {
+            return arena_block(arena->create<OperationBlock>());
+        }
+        else if (block_type == BlockType::UNIT_DELAY)
+        {
+            return arena_block(arena->create<UnitDelayBlock>());
+        }
+        else
+        {
+            return arena_block(arena->create<BaseBlock>());
+        }
+    }
+
+    void Parser::parse_subsystem(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml, const std::string& path)
+    {
+        if (!block_ptr)
+        {
+            throw std::logic_error("Empty block pointer in parse_subsystem Parser's method");
+        }
+
+        xml::XMLElement *system_xml = block_xml->FirstChildElement("System");
+        if (!system_xml)
+            throw std::invalid_argument("Parser: subsystem " + block_name(*block_ptr, names) + " has no <System>");
+
+        std::shared_ptr<SubSystemBlock> subsystem_ptr = std::dynamic_pointer_cast<SubSystemBlock>(block_ptr);
+        SystemBlocks system_blocks = parse_system(system_xml, path);
+        subsystems.push_back(subsystem_ptr);
+
+        //inner Inport/Outport blocks are boundaries numbered by "Port" parameter (1 by default);
+        //other blocks are collected in document order, so SIDs given to them by flattening don't depend on hash order
+        for (xml::XMLElement *inner_xml = system_xml->FirstChildElement("Block"); inner_xml != nullptr; inner_xml = inner_xml->NextSiblingElement("Block"))
+        {
+            const char *attributes[3];
+            inner_xml->FindAttributes(block_attributes, attributes, 3);
+            const char *sid = attributes[1];
+            if (!sid)
+                continue;
+            const auto& inner_block_ptr = system_blocks.at(count_value(sid, "SID"));
+            if (inner_block_ptr->type == BlockType::SUBSYSTEM)
+                continue;
+            if (inner_block_ptr->type != BlockType::INPORT && inner_block_ptr->type != BlockType::OUTPORT)
             {
-                block_ptr = std::make_shared<UnitDelayBlock>();
+                nested_blocks.push_back(inner_block_ptr);
+                continue;
             }
-            else
+
+            size_t port_number = 1;
+            for (xml::XMLElement *param = inner_xml->FirstChildElement("P"); param != nullptr; param = param->NextSiblingElement("P"))
             {
-                block_ptr = std::make_shared<BaseBlock>();
+                const char *param_name = param->Attribute("Name");
+                const char *param_value = param->GetText();
+                if (param_name && param_value && std::string(param_name) == "Port")
+                    port_number = count_value(param_value, "Port");
             }
-
-            block_ptr = parse_block(block_ptr, block_xml, name, sid, block_type);
-            parser_res.insert({block_ptr->sid, block_ptr});
+            //blocks read through a boundary that isn't in the map would be left dangling after flattening
+            bool is_inport = inner_block_ptr->type == BlockType::INPORT;
+            auto &boundaries = is_inport ? subsystem_ptr->inports : subsystem_ptr->outports;
+            if (!boundaries.insert({port_number, inner_block_ptr}).second)
+                throw std::invalid_argument("Parser: subsystem " + path + " has several " + (is_inport ? "inports" : "outports") +
+                                            " numbered " + std::to_string(port_number));
         }
-        return parser_res;
     }
 
     bool Parser::is_block_correct(const char* name, const char* sid, const char* type)
@@ -85,20 +266,32 @@ namespace generator
     }
 
     std::shared_ptr<BaseBlock> Parser::parse_block(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml, const std::string& name, 
-                                           const std::string& sid, BlockType block_type)
+                                           size_t sid, BlockType block_type)
     {
         if (!block_ptr)
         {
             throw std::logic_error("Empty block pointer in parse_block Parser's method");
         }
 
-        std::string name_no_spaces = name;
-        name_no_spaces.erase(std::remove_if(name_no_spaces.begin(), name_no_spaces.end(), [](unsigned char c)
-                                 { return std::isspace(c); }), name_no_spaces.end());
-        block_ptr->name = name_no_spaces;
-        block_ptr->sid = std::stoi(sid);
+        if (sid > UINT32_MAX)
+            throw std::invalid_argument("Parser: sid = " + std::to_string(sid) + " doesn't fit in 32 bits");
+        block_ptr->name = names.intern(name);
+        block_ptr->sid = static_cast<uint32_t>(sid);
         block_ptr->type = block_type;
         block_ptr->is_port = false;
+        block_ptr->port_name = 0;
+        block_ptr->width = 1;
+        block_ptr->sample_time = -1;
+
+        for (xml::XMLElement *param = block_xml->FirstChildElement("P"); param != nullptr; param = param->NextSiblingElement("P"))
+        {
+            const char *param_name = param->Attribute("Name");
+            const char *param_value = param->GetText();
+            if (param_name && param_value && std::string(param_name) == "PortDimensions")
+                block_ptr->width = parse_port_dimensions(param_value);
+            if (param_name && param_value && std::string(param_name) == "SampleTime")
+                block_ptr->sample_time = parse_sample_time(param_value);
+        }
 
         for (xml::XMLElement *port = block_xml->FirstChildElement("Port"); port != nullptr; port = port->NextSiblingElement("Port"))
         {
@@ -109,16 +302,25 @@ namespace generator
                 if (param_name && param_value)
                 {
                     std::string param_name_str = param_name;
-                    std::string param_value_str = param_value;
                     block_ptr->is_port = true;
                     if (param_name_str == "Name")
-                        block_ptr->port_name = param_value_str;
+                        block_ptr->port_name = names.intern(param_value);
                 }
             }
         }
 
         if (is_operation(block_type))
             add_operation_block_info(block_ptr, block_xml);
+        if (block_type == BlockType::DISCRETE_FILTER)
+            add_filter_block_info(block_ptr, block_xml);
+        if (block_type == BlockType::LOOKUP)
+            add_lookup_block_info(block_ptr, block_xml);
+        if (block_type == BlockType::SATURATION)
+            add_saturation_block_info(block_ptr, block_xml);
+        if (block_type == BlockType::SWITCH)
+            add_switch_block_info(block_ptr, block_xml);
+        if (block_type == BlockType::CONSTANT)
+            add_constant_block_info(block_ptr, block_xml);
         
         return block_ptr;
     } 
@@ -131,7 +333,7 @@ namespace generator
         }
 
         std::shared_ptr<OperationBlock> oper_block_ptr = std::dynamic_pointer_cast<OperationBlock>(block_ptr);
-        oper_block_ptr->inputs = "";
+        std::string inputs; //for add operations it may have value like "+-", for product like "*/"; empty string means all "+" or "*"
 
         for (xml::XMLElement *param = block_xml->FirstChildElement("P"); param != nullptr; param = param->NextSiblingElement("P"))
         {
@@ -143,17 +345,267 @@ namespace generator
                 auto param_value_str = std::string(param_value);
                 if (param_name_str == "Inputs")
                 {
-                    oper_block_ptr->inputs = param_value_str;
+                    inputs = param_value_str;
                 }
                 else if (param_name_str == "Gain")
                 {
-                    oper_block_ptr->gain = std::stod(param_value_str);
+                    oper_block_ptr->gain = number_value(param_value, "Gain");
+                }
+            }
+        }
+
+        //"|" only spaces icon ports; a number means that many inputs with default operator
+        inputs.erase(std::remove(inputs.begin(), inputs.end(), '|'), inputs.end());
+        bool is_count = !inputs.empty() && std::all_of(inputs.begin(), inputs.end(), [](unsigned char c) { return std::isdigit(c); });
+        size_t ports_count = is_count ? count_value(inputs.c_str(), "Inputs") : inputs.size();
+        if (ports_count > UINT16_MAX)
+            throw std::invalid_argument("Parser: too many inputs of block " + block_name(*block_ptr, names));
+        oper_block_ptr->in_ports.declared = static_cast<uint16_t>(ports_count);
+
+        //signs are kept as bits of subtracting or dividing ports
+        char inverted_sign = oper_block_ptr->type == BlockType::PRODUCT ? '/' : '-';
+        for (size_t port = 0; port < inputs.size() && !is_count; ++port)
+        {
+            if (inputs[port] == inverted_sign)
+                oper_block_ptr->in_ports.set_inverted(port);
+        }
+    }
+
+    void Parser::add_saturation_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml)
+    {
+        if (!block_ptr)
+        {
+            throw std::logic_error("Empty block pointer in add_saturation_block_info Parser's method");
+        }
+
+        std::shared_ptr<SaturationBlock> saturation_block_ptr = std::dynamic_pointer_cast<SaturationBlock>(block_ptr);
+        //defaults of Simulink Saturate block
+        saturation_block_ptr->upper_limit = 0.5;
+        saturation_block_ptr->lower_limit = -0.5;
+
+        for (xml::XMLElement *param = block_xml->FirstChildElement("P"); param != nullptr; param = param->NextSiblingElement("P"))
+        {
+            const char *param_name = param->Attribute("Name");
+            const char *param_value = param->GetText();
+            if (param_name && param_value)
+            {
+                auto param_name_str = std::string(param_name);
+                if (param_name_str == "UpperLimit")
+                    saturation_block_ptr->upper_limit = number_value(param_value, "UpperLimit");
+                else if (param_name_str == "LowerLimit")
+                    saturation_block_ptr->lower_limit = number_value(param_value, "LowerLimit");
+            }
+        }
+
+        if (saturation_block_ptr->lower_limit > saturation_block_ptr->upper_limit)
+            throw std::invalid_argument("Parser: saturation lower limit is greater than upper limit, block " + block_name(*block_ptr, names));
+    }
+
+    void Parser::add_switch_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml)
+    {
+        if (!block_ptr)
+        {
+            throw std::logic_error("Empty block pointer in add_switch_block_info Parser's method");
+        }
+
+        std::shared_ptr<SwitchBlock> switch_block_ptr = std::dynamic_pointer_cast<SwitchBlock>(block_ptr);
+        //defaults of Simulink Switch block
+        switch_block_ptr->criteria = SwitchCriteria::GREATER_OR_EQUAL;
+        switch_block_ptr->threshold = 0;
+
+        for (xml::XMLElement *param = block_xml->FirstChildElement("P"); param != nullptr; param = param->NextSiblingElement("P"))
+        {
+            const char *param_name = param->Attribute("Name");
+            const char *param_value = param->GetText();
+            if (param_name && param_value)
+            {
+                auto param_name_str = std::string(param_name);
+                auto param_value_str = std::string(param_value);
+                if (param_name_str == "Threshold")
+                {
+                    switch_block_ptr->threshold = number_value(param_value, "Threshold");
+                }
+                else if (param_name_str == "Criteria")
+                {
+                    if (param_value_str == "u2 >= Threshold")
+                        switch_block_ptr->criteria = SwitchCriteria::GREATER_OR_EQUAL;
+                    else if (param_value_str == "u2 > Threshold")
+                        switch_block_ptr->criteria = SwitchCriteria::GREATER;
+                    else if (param_value_str == "u2 ~= 0")
+                        switch_block_ptr->criteria = SwitchCriteria::NOT_ZERO;
+                    else
+                        throw std::invalid_argument("Parser: invalid switch criteria " + param_value_str);
                 }
             }
         }
     }
 
-    void Parser::parse_lines(ParserResult& blocks_ptr, xml::XMLElement *root_xml)
+    void Parser::add_constant_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml)
+    {
+        if (!block_ptr)
+        {
+            throw std::logic_error("Empty block pointer in add_constant_block_info Parser's method");
+        }
+
+        std::shared_ptr<ConstantBlock> constant_block_ptr = std::dynamic_pointer_cast<ConstantBlock>(block_ptr);
+        constant_block_ptr->value = {1}; //default of Simulink Constant block
+
+        for (xml::XMLElement *param = block_xml->FirstChildElement("P"); param != nullptr; param = param->NextSiblingElement("P"))
+        {
+            const char *param_name = param->Attribute("Name");
+            const char *param_value = param->GetText();
+            if (param_name && param_value && std::string(param_name) == "Value")
+                constant_block_ptr->value = parse_coefficients(param_value, "Value");
+        }
+
+        if (constant_block_ptr->value.empty())
+            throw std::invalid_argument("Parser: constant block has no value, block " + block_name(*block_ptr, names));
+        if (constant_block_ptr->value.size() > 1)
+            block_ptr->width = constant_block_ptr->value.size();
+        else
+            constant_block_ptr->value.resize(block_ptr->width, constant_block_ptr->value[0]);
+    }
+
+    void Parser::add_filter_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml)
+    {
+        if (!block_ptr)
+        {
+            throw std::logic_error("Empty block pointer in add_filter_block_info Parser's method");
+        }
+
+        std::shared_ptr<DiscreteFilterBlock> filter_block_ptr = std::dynamic_pointer_cast<DiscreteFilterBlock>(block_ptr);
+        //defaults of Simulink DiscreteFilter block
+        filter_block_ptr->numerator = {1};
+        filter_block_ptr->denominator = {1, 0.5};
+
+        for (xml::XMLElement *param = block_xml->FirstChildElement("P"); param != nullptr; param = param->NextSiblingElement("P"))
+        {
+            const char *param_name = param->Attribute("Name");
+            const char *param_value = param->GetText();
+            if (param_name && param_value)
+            {
+                auto param_name_str = std::string(param_name);
+                if (param_name_str == "Numerator")
+                    filter_block_ptr->numerator = parse_coefficients(param_value, "Numerator");
+                else if (param_name_str == "Denominator")
+                    filter_block_ptr->denominator = parse_coefficients(param_value, "Denominator");
+            }
+        }
+
+        if (filter_block_ptr->numerator.empty() || filter_block_ptr->denominator.empty() || filter_block_ptr->denominator[0] == 0)
+            throw std::invalid_argument("Parser: invalid DiscreteFilter coefficients in block " + block_name(*block_ptr, names));
+
+        double a0 = filter_block_ptr->denominator[0];
+        for (auto& b: filter_block_ptr->numerator)
+            b /= a0;
+        for (auto& a: filter_block_ptr->denominator)
+            a /= a0;
+        while (filter_block_ptr->denominator.size() > 1 && filter_block_ptr->denominator.back() == 0)
+            filter_block_ptr->denominator.pop_back();
+    }
+
+    void Parser::add_lookup_block_info(const std::shared_ptr<BaseBlock>& block_ptr, tinyxml2::XMLElement *block_xml)
+    {
+        if (!block_ptr)
+        {
+            throw std::logic_error("Empty block pointer in add_lookup_block_info Parser's method");
+        }
+
+        std::shared_ptr<LookupBlock> lookup_block_ptr = std::dynamic_pointer_cast<LookupBlock>(block_ptr);
+        size_t dimensions = 2; //default of Simulink Lookup_n-D block
+        lookup_block_ptr->breakpoints.resize(2);
+
+        for (xml::XMLElement *param = block_xml->FirstChildElement("P"); param != nullptr; param = param->NextSiblingElement("P"))
+        {
+            const char *param_name = param->Attribute("Name");
+            const char *param_value = param->GetText();
+            if (param_name && param_value)
+            {
+                auto param_name_str = std::string(param_name);
+                if (param_name_str == "NumberOfTableDimensions")
+                    dimensions = count_value(param_value, "NumberOfTableDimensions");
+                else if (param_name_str == "Table")
+                    lookup_block_ptr->table = parse_coefficients(param_value, "Table");
+                else if (param_name_str == "BreakpointsForDimension1")
+                    lookup_block_ptr->breakpoints[0] = parse_coefficients(param_value, "BreakpointsForDimension1");
+                else if (param_name_str == "BreakpointsForDimension2")
+                    lookup_block_ptr->breakpoints[1] = parse_coefficients(param_value, "BreakpointsForDimension2");
+            }
+        }
+
+        if (dimensions != 1 && dimensions != 2)
+            throw std::invalid_argument("Parser: only 1-D and 2-D lookup tables are supported, block " + block_name(*block_ptr, names));
+        lookup_block_ptr->breakpoints.resize(dimensions);
+
+        size_t table_size = 1;
+        for (const auto& breakpoints: lookup_block_ptr->breakpoints)
+        {
+            if (breakpoints.size() < 2 || std::adjacent_find(breakpoints.begin(), breakpoints.end(), std::greater_equal<double>()) != breakpoints.end())
+                throw std::invalid_argument("Parser: lookup breakpoints must have at least 2 strictly increasing values, block " + block_name(*block_ptr, names));
+            table_size *= breakpoints.size();
+        }
+        if (lookup_block_ptr->table.size() != table_size)
+            throw std::invalid_argument("Parser: lookup table size doesn't match breakpoints, block " + block_name(*block_ptr, names));
+    }
+
+    std::vector<double> Parser::parse_coefficients(const std::string& coefficients_str, const std::string& what)
+    {
+        //value looks like "[1 0.5 0.25]", "[1, 0.5, 0.25]" or "[1 2; 3 4]"; workspace variables and expressions aren't supported
+        const char *separators = "[],; \t\r\n";
+        std::vector<double> coefficients;
+        for (const char *pos = coefficients_str.c_str(); *(pos += std::strspn(pos, separators));)
+        {
+            double coefficient;
+            const char *end = xml::XMLUtil::ReadDouble(pos, &coefficient);
+            if (!end || !std::strchr(separators, *end) || !std::isfinite(coefficient))
+                throw std::invalid_argument("Parser: " + what + " isn't a number: " + coefficients_str);
+            coefficients.push_back(coefficient);
+            pos = end;
+        }
+        return coefficients;
+    }
+
+    size_t Parser::parse_port_dimensions(const std::string& dimensions_str)
+    {
+        //value may look like "3", "[3]" or "[2, 3]"; width is product of dimensions, -1 means inherited
+        size_t width = 1;
+        for (const char *pos = dimensions_str.c_str(); *(pos += std::strcspn(pos, "-0123456789"));)
+        {
+            int dimension;
+            const char *end = xml::XMLUtil::ReadInt(pos, &dimension);
+            if (!end)
+                throw std::invalid_argument("Parser: invalid PortDimensions value " + dimensions_str);
+            pos = end;
+            if (dimension == -1)
+                return 1;
+            if (dimension <= 0)
+                throw std::invalid_argument("Parser: invalid PortDimensions value " + dimensions_str);
+            width *= dimension;
+        }
+        return width;
+    }
+
+    double Parser::parse_sample_time(const std::string& sample_time_str)
+    {
+        //value may look like "0.01", "[0.01 0]" (period and offset), "-1" or "inf"; both of latter mean inherited
+        size_t first = sample_time_str.find_first_not_of(" \t\r\n");
+        size_t last = sample_time_str.find_last_not_of(" \t\r\n");
+        std::string trimmed = first == std::string::npos ? "" : sample_time_str.substr(first, last - first + 1);
+        if (trimmed == "inf" || trimmed == "Inf")
+            return -1;
+        std::vector<double> values = parse_coefficients(sample_time_str, "SampleTime");
+        if (values.empty())
+            throw std::invalid_argument("Parser: SampleTime isn't a number: " + sample_time_str);
+        if (values[0] < 0)
+            return -1;
+        if (values[0] == 0)
+            throw std::invalid_argument("Parser: continuous SampleTime isn't supported " + sample_time_str);
+        if (values.size() > 1 && values[1] != 0)
+            throw std::invalid_argument("Parser: SampleTime offset isn't supported " + sample_time_str);
+        return values[0];
+    }
+
+    void Parser::parse_lines(SystemBlocks& blocks_ptr, xml::XMLElement *root_xml)
     {
         if (blocks_ptr.size() == 0)
             throw std::logic_error("Empty blocks map in parse_lines Parser's method");
@@ -163,10 +615,10 @@ namespace generator
         }
     }
 
-    void Parser::parse_line(ParserResult& blocks_ptr, tinyxml2::XMLElement *line_xml)
+    void Parser::parse_line(SystemBlocks& blocks_ptr, tinyxml2::XMLElement *line_xml)
     {
-        size_t src_sid;
-        std::vector<std::pair<uint8_t, size_t>> dsts; //dst_in_port - dst_sid
+        std::pair<size_t, size_t> src; //src_sid - src_out_port
+        std::vector<std::pair<size_t, size_t>> dsts; //dst_in_port - dst_sid
         for (xml::XMLElement *param = line_xml->FirstChildElement("P"); param != nullptr; param = param->NextSiblingElement("P"))
         {
             const char *param_name = param->Attribute("Name");
@@ -174,24 +626,13 @@ namespace generator
             if (param_name && param_value)
             {
                 auto param_name_str = std::string(param_name);
-                auto param_value_str = std::string(param_value);
                 if (param_name_str == "Src")
                 {
-                    src_sid = std::stoi(param_value_str);
-                    if (blocks_ptr.find(src_sid) == blocks_ptr.end())
-                        throw std::out_of_range("Parser: line has block with sid = " + std::to_string(src_sid) + "which doesn't parsed");
+                    src = parse_endpoint(blocks_ptr, param_value);
                 }
                 else if (param_name_str == "Dst")
                 {
-                    size_t dst_sid = std::stoi(param_value_str);
-                    if (blocks_ptr.find(dst_sid) == blocks_ptr.end())
-                        throw std::out_of_range("Parser: line has block with sid = " + std::to_string(dst_sid) + "which doesn't parsed");
-                    size_t colon_pos = param_value_str.find(':');
-                    size_t dst_port = 0;
-                    if (colon_pos != std::string::npos)
-                    {
-                        dst_port = std::stoi(param_value_str.substr(colon_pos + 1));
-                    }
+                    auto [dst_sid, dst_port] = parse_endpoint(blocks_ptr, param_value);
                     dsts.push_back({dst_port, dst_sid});
                 }
             }
@@ -200,23 +641,33 @@ namespace generator
 
         for (const auto& [dst_port, dst_sid]: dsts)
         {
-            blocks_ptr[src_sid]->next_blocks.push_back(blocks_ptr[dst_sid]);
-
-            if (is_operation(blocks_ptr[dst_sid]->type))
-            {
-               std::shared_ptr<OperationBlock> oper_block_ptr = std::dynamic_pointer_cast<OperationBlock>(blocks_ptr[dst_sid]);
-               oper_block_ptr->in_ports.insert({dst_port, blocks_ptr[src_sid]});
-            }
+            connections.push_back({blocks_ptr[src.first], src.second, blocks_ptr[dst_sid], dst_port});
+        }
+    }
 
-            if (blocks_ptr[dst_sid]->type == BlockType::UNIT_DELAY)
-            {
-                std::shared_ptr<UnitDelayBlock> ud_block_ptr = std::dynamic_pointer_cast<UnitDelayBlock>(blocks_ptr[dst_sid]);
-                ud_block_ptr->input = blocks_ptr[src_sid];
-            }
+    std::pair<size_t, size_t> Parser::parse_endpoint(const SystemBlocks& blocks_ptr, const char* endpoint_str)
+    {
+        //endpoint looks like "17#in:2" or "17#out:1"
+        uint64_t sid;
+        const char *sid_end = xml::XMLUtil::ReadUnsigned64(endpoint_str, &sid);
+        if (!sid_end || (*sid_end != '#' && *sid_end != ':' && !is_whole_value(sid_end)))
+            throw std::invalid_argument(std::string("Parser: line endpoint SID isn't a non-negative integer: ") + endpoint_str);
+        if (blocks_ptr.find(sid) == blocks_ptr.end())
+            throw std::out_of_range("Parser: line has block with sid = " + std::to_string(sid) + "which doesn't parsed");
+        const char *colon = std::strchr(endpoint_str, ':');
+        size_t port = 0;
+        if (colon)
+        {
+            port = count_value(colon + 1, "line endpoint port");
+            //operation inputs are stored in InputPorts, which numbers them with 16 bits
+            if (port > UINT16_MAX)
+                throw std::invalid_argument("Parser: line endpoint port " + std::to_string(port) + " of block with sid = " + std::to_string(sid) +
+                                            " is above port limit " + std::to_string(UINT16_MAX));
         }
+        return {sid, port};
     }
 
-    void Parser::parse_branch(std::vector<std::pair<uint8_t, size_t>>& dsts, const ParserResult& blocks_ptr, tinyxml2::XMLElement *line_xml)
+    void Parser::parse_branch(std::vector<std::pair<size_t, size_t>>& dsts, const SystemBlocks& blocks_ptr, tinyxml2::XMLElement *line_xml)
     {
         for (xml::XMLElement *branch = line_xml->FirstChildElement("Branch"); branch != nullptr; branch = branch->NextSiblingElement("Branch"))
         {
@@ -227,22 +678,192 @@ namespace generator
                 if (param_name && param_value)
                 {
                     auto param_name_str = std::string(param_name);
-                    auto param_value_str = std::string(param_value);
                     if (param_name_str == "Dst")
                     {
-                        size_t dst_sid = std::stoi(param_value_str);
-                        if (blocks_ptr.find(dst_sid) == blocks_ptr.end())
-                            throw std::out_of_range("Parser: line has block with sid = " + std::to_string(dst_sid) + "which doesn't parsed");
-                        size_t colon_pos = param_value_str.find(':');
-                        size_t dst_port = 0;
-                        if (colon_pos != std::string::npos)
-                        {
-                            dst_port = std::stoi(param_value_str.substr(colon_pos + 1));
-                        }
+                        auto [dst_sid, dst_port] = parse_endpoint(blocks_ptr, param_value);
                         dsts.push_back({dst_port, dst_sid});
                     }
                 }
             }
         }
     }
+
+    void Parser::flatten_subsystems(SystemBlocks& blocks_ptr)
+    {
+        //root keeps its SIDs, nested blocks get fresh ones after the largest root SID
+        size_t next_sid = 0;
+        for (const auto& [sid, _]: blocks_ptr)
+            next_sid = std::max(next_sid, sid + 1);
+        for (auto it = blocks_ptr.begin(); it != blocks_ptr.end();)
+        {
+            if (it->second->type == BlockType::SUBSYSTEM)
+                it = blocks_ptr.erase(it);
+            else
+                ++it;
+        }
+        if (next_sid + nested_blocks.size() > UINT32_MAX)
+            throw std::invalid_argument("Parser: flattened model has too many blocks for 32-bit sids");
+        for (const auto& block_ptr: nested_blocks)
+        {
+            block_ptr->sid = static_cast<uint32_t>(next_sid++);
+            blocks_ptr.insert({block_ptr->sid, block_ptr});
+        }
+
+        Drivers drivers;
+        for (const auto& connection: connections)
+            drivers[{connection.dst.get(), connection.dst_port}] = &connection;
+        std::unordered_map<BaseBlock*, std::pair<std::shared_ptr<BaseBlock>, size_t>> boundary_inports; //inner Inport - subsystem, port number
+        for (const auto& subsystem_ptr: subsystems)
+        {
+            for (const auto& [port_number, inport_ptr]: subsystem_ptr->inports)
+                boundary_inports[inport_ptr.get()] = {subsystem_ptr, port_number};
+        }
+
+        //lines into subsystem or inner Outport are only boundary hops, the real consumer reads the resolved source
+        for (const auto& connection: connections)
+        {
+            auto dst = blocks_ptr.find(connection.dst->sid);
+            if (dst == blocks_ptr.end() || dst->second != connection.dst)
+                continue;
+            connect_blocks(resolve_source(connection.src, connection.src_port, drivers, boundary_inports), connection.dst, connection.dst_port);
+        }
+    }
+
+    std::shared_ptr<BaseBlock> Parser::resolve_source(std::shared_ptr<BaseBlock> src, size_t src_port, const Drivers& drivers,
+                                                      const std::unordered_map<BaseBlock*, std::pair<std::shared_ptr<BaseBlock>, size_t>>& boundary_inports)
+    {
+        auto find_driver = [this, &drivers](const std::shared_ptr<BaseBlock>& dst, size_t dst_port) -> const Connection&
+        {
+            auto driver = drivers.find({dst.get(), dst_port});
+            if (driver == drivers.end())
+                throw std::out_of_range("Parser: port " + std::to_string(dst_port) + " of block " + block_name(*dst, names) + " isn't connected");
+            return *driver->second;
+        };
+
+        //hop through subsystem outputs and inner inports until a real block is reached;
+        //coming back to a hop already passed means wires close a loop without any block on it
+        std::set<std::pair<BaseBlock*, size_t>> passed_hops; //block, output port
+        while (true)
+        {
+            if (!passed_hops.insert({src.get(), src_port}).second)
+                throw std::invalid_argument("Parser: wire loop through output " + std::to_string(src_port) + " of block " + block_name(*src, names) +
+                                            ", signal has no block producing it");
+            if (src->type == BlockType::SUBSYSTEM)
+            {
+                std::shared_ptr<SubSystemBlock> subsystem_ptr = std::dynamic_pointer_cast<SubSystemBlock>(src);
+                auto outport = subsystem_ptr->outports.find(src_port);
+                if (outport == subsystem_ptr->outports.end())
+                    throw std::out_of_range("Parser: subsystem " + block_name(*src, names) + " has no outport " + std::to_string(src_port));
+                const auto& driver = find_driver(outport->second, 1);
+                src = driver.src;
+                src_port = driver.src_port;
+            }
+            else if (auto inport = boundary_inports.find(src.get()); inport != boundary_inports.end())
+            {
+                const auto& driver = find_driver(inport->second.first, inport->second.second);
+                src = driver.src;
+                src_port = driver.src_port;
+            }
+            else
+            {
+                return src;
+            }
+        }
+    }
+
+    void Parser::connect_blocks(const std::shared_ptr<BaseBlock>& src, const std::shared_ptr<BaseBlock>& dst, size_t dst_port)
+    {
+        if (is_operation(dst->type))
+        {
+           std::shared_ptr<OperationBlock> oper_block_ptr = std::dynamic_pointer_cast<OperationBlock>(dst);
+           if (dst_port == 0)
+               throw std::invalid_argument("Parser: invalid port 0 of block " + block_name(*dst, names));
+           if (oper_block_ptr->in_ports.size() < dst_port)
+               oper_block_ptr->in_ports.resize(dst_port);
+           if (oper_block_ptr->in_ports[dst_port - 1])
+               throw std::invalid_argument("Parser: port " + std::to_string(dst_port) + " of block " + block_name(*dst, names) + " has several drivers");
+           oper_block_ptr->in_ports[dst_port - 1] = src.get();
+        }
+
+        if (dst->type == BlockType::UNIT_DELAY)
+        {
+            std::shared_ptr<UnitDelayBlock> ud_block_ptr = std::dynamic_pointer_cast<UnitDelayBlock>(dst);
+            ud_block_ptr->input = src.get();
+        }
+    }
+
+    void Parser::check_ports(const SystemBlocks& blocks_ptr)
+    {
+        for (const auto& [_, block_ptr]: blocks_ptr)
+        {
+            if (!is_operation(block_ptr->type))
+                continue;
+            std::shared_ptr<OperationBlock> oper_block_ptr = std::dynamic_pointer_cast<OperationBlock>(block_ptr);
+
+            //sum and product have a port per sign, without signs any number of ports is accepted
+            size_t ports_count = 1;
+            if (block_ptr->type == BlockType::SUM || block_ptr->type == BlockType::PRODUCT)
+                ports_count = oper_block_ptr->in_ports.declared == 0 ? std::max<size_t>(oper_block_ptr->in_ports.size(), 1) : oper_block_ptr->in_ports.declared;
+            else if (block_ptr->type == BlockType::SWITCH)
+                ports_count = 3;
+            else if (block_ptr->type == BlockType::LOOKUP)
+                ports_count = std::dynamic_pointer_cast<LookupBlock>(block_ptr)->breakpoints.size();
+
+            if (oper_block_ptr->in_ports.size() > ports_count)
+                throw std::invalid_argument("Parser: block " + block_name(*block_ptr, names) + " has " + std::to_string(ports_count) + " input ports, line goes to port " +
+                                            std::to_string(oper_block_ptr->in_ports.size()));
+            oper_block_ptr->in_ports.resize(ports_count);
+            for (size_t port = 0; port < ports_count; ++port)
+            {
+                if (!oper_block_ptr->in_ports[port])
+                    throw std::invalid_argument("Parser: port " + std::to_string(port + 1) + " of block " + block_name(*block_ptr, names) + " isn't connected");
+            }
+        }
+    }
+
+    void Parser::propagate_widths(SystemBlocks& blocks_ptr)
+    {
+        //operation and unit delay outputs take the widest input, scalar inputs are broadcast
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto& [_, block_ptr]: blocks_ptr)
+            {
+                size_t width = block_ptr->width;
+                if (is_operation(block_ptr->type))
+                {
+                    std::shared_ptr<OperationBlock> oper_block_ptr = std::dynamic_pointer_cast<OperationBlock>(block_ptr);
+                    for (const auto& input_ptr: oper_block_ptr->in_ports)
+                        width = std::max<size_t>(width, input_ptr->width);
+                }
+                else if (block_ptr->type == BlockType::UNIT_DELAY)
+                {
+                    std::shared_ptr<UnitDelayBlock> ud_block_ptr = std::dynamic_pointer_cast<UnitDelayBlock>(block_ptr);
+                    if (ud_block_ptr->input)
+                        width = std::max<size_t>(width, ud_block_ptr->input->width);
+                }
+                if (width != block_ptr->width)
+                {
+                    block_ptr->width = static_cast<uint32_t>(width);
+                    changed = true;
+                }
+            }
+        }
+
+        for (const auto& [_, block_ptr]: blocks_ptr)
+        {
+            if (!is_operation(block_ptr->type))
+                continue;
+            std::shared_ptr<OperationBlock> oper_block_ptr = std::dynamic_pointer_cast<OperationBlock>(block_ptr);
+            for (const auto& input_ptr: oper_block_ptr->in_ports)
+            {
+                size_t input_width = input_ptr->width;
+                if (input_width != 1 && input_width != block_ptr->width)
+                    throw std::invalid_argument("Parser: signal width mismatch at block " + block_name(*block_ptr, names));
+            }
+            if ((block_ptr->type == BlockType::DISCRETE_FILTER || block_ptr->type == BlockType::LOOKUP) && block_ptr->width != 1)
+                throw std::invalid_argument("Parser: DiscreteFilter and Lookup_n-D support only scalar signals, block " + block_name(*block_ptr, names));
+        }
+    }
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "watcher.h"
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace generator
+{
+    namespace
+    {
+        std::string system_error(const std::string& what)
+        {
+            return "Watcher: " + what + ": " + std::strerror(errno);
+        }
+
+        const int request_timeout_ms = 1000;
+    }
+
+    Watcher::Watcher(const std::string& model_path, const std::string& file_name, const GeneratorOptions& options)
+        : model_path(model_path), file_name(file_name), socket_path(file_name + ".sock"), options(options)
+    {
+        //editors often save by renaming a temporary file, so directory is watched rather than the file itself
+        size_t slash_pos = model_path.rfind('/');
+        std::string directory = slash_pos == std::string::npos ? "." : model_path.substr(0, slash_pos + 1);
+        inotify_fd = inotify_init1(IN_CLOEXEC);
+        if (inotify_fd < 0)
+            throw std::runtime_error(system_error("inotify_init1 failed"));
+        if (inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+            throw std::runtime_error(system_error("can't watch " + directory));
+
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path))
+            throw std::invalid_argument("Watcher: socket path is too long " + socket_path);
+        std::strcpy(address.sun_path, socket_path.c_str());
+        socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (socket_fd < 0)
+            throw std::runtime_error(system_error("socket failed"));
+
+        //only a socket left by a watcher that is gone is removed, anything else at the path is kept
+        struct stat path_stat;
+        if (lstat(socket_path.c_str(), &path_stat) == 0)
+        {
+            if (!S_ISSOCK(path_stat.st_mode))
+                throw std::runtime_error("Watcher: " + socket_path + " exists and isn't a socket");
+            int probe_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            bool is_listened = probe_fd >= 0 && connect(probe_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+            if (probe_fd >= 0)
+                close(probe_fd);
+            if (is_listened)
+                throw std::runtime_error("Watcher: another watcher listens on " + socket_path);
+            unlink(socket_path.c_str());
+        }
+        if (bind(socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(socket_fd, 8) < 0)
+            throw std::runtime_error(system_error("can't listen on " + socket_path));
+    }
+
+    Watcher::~Watcher()
+    {
+        if (socket_fd >= 0)
+        {
+            close(socket_fd);
+            unlink(socket_path.c_str());
+        }
+        if (inotify_fd >= 0)
+            close(inotify_fd);
+    }
+
+    void Watcher::run()
+    {
+        regenerate();
+        std::cerr << "Watcher: watching " << model_path << ", requests on " << socket_path << std::endl;
+        pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {socket_fd, POLLIN, 0}};
+        while (true)
+        {
+            if (poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error(system_error("poll failed"));
+            }
+            if (fds[0].revents & POLLIN)
+                handle_model_events();
+            if (fds[1].revents & POLLIN)
+                handle_request();
+        }
+    }
+
+    void Watcher::regenerate()
+    {
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            if (parser)
+                parser->load(model_path);
+            else
+                parser = std::make_unique<Parser>(model_path);
+            Generator code_generator(parser->parse(), options);
+            code_generator.keep_chunk_cache(&chunk_cache);
+            code_generator.generate_code("nwocg", file_name);
+        }
+        catch (const std::exception& e)
+        {
+            //half-saved or broken model keeps the previous code, next save retries
+            last_error = e.what();
+            std::cerr << last_error << std::endl;
+            return;
+        }
+        is_dirty = false;
+        last_error.clear();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        std::cerr << "Watcher: " << file_name << ".c regenerated in " << duration.count() / 1000.0 << " ms" << std::endl;
+    }
+
+    void Watcher::handle_model_events()
+    {
+        std::string model_name = model_path.substr(model_path.rfind('/') + 1);
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length < 0)
+            throw std::runtime_error(system_error("can't read inotify events"));
+
+        //one save may produce several events, they are handled by one regeneration
+        for (ssize_t pos = 0; pos < length;)
+        {
+            const inotify_event *event = reinterpret_cast<const inotify_event*>(buffer + pos);
+            //dropped events may have been a save
+            if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && model_name == event->name))
+                is_dirty = true;
+            pos += sizeof(inotify_event) + event->len;
+        }
+        if (is_dirty)
+            regenerate();
+    }
+
+    void Watcher::handle_request()
+    {
+        //any request means "make generated code up to date", reply is "ok" or "error <message>"
+        int client_fd = accept4(socket_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (client_fd < 0)
+            return;
+        //a client that connects and stays silent is dropped after a while, so model events keep being handled
+        pollfd client = {client_fd, POLLIN, 0};
+        char request[256];
+        //a client closing without a request, like the probe of a starting watcher, gets no reply
+        if (poll(&client, 1, request_timeout_ms) > 0 && read(client_fd, request, sizeof(request)) > 0)
+        {
+            if (is_dirty)
+                regenerate();
+            std::string reply = last_error.empty() ? "ok\n" : "error " + last_error + "\n";
+            //client may be gone already, that mustn't kill the daemon with SIGPIPE
+            if (send(client_fd, reply.data(), reply.size(), MSG_NOSIGNAL) < 0)
+                std::cerr << system_error("can't reply to request") << std::endl;
+        }
+        close(client_fd);
+    }
+
+}
@@ -0,0 +1,160 @@
+#include <parser.h>
+#include "test_models.h"
+
+#include <malloc.h>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+//prints heap bytes per block of a parse result and of the same blocks in the layout used before name interning;
+//fails if the compact result isn't at least 4 times smaller
+
+namespace
+{
+size_t live_bytes = 0; //heap bytes currently allocated through operator new, as malloc reserved them
+
+//block records as they were before names were interned: strings per block, weak pointers to inputs and outputs,
+//sign string, a heap allocation per block and a hash map from sid
+struct LegacyBlock
+{
+    std::string name;
+    generator::BlockType type;
+    bool is_port;
+    size_t sid;
+    size_t width;
+    double sample_time;
+    std::vector<std::weak_ptr<LegacyBlock>> next_blocks;
+    std::string port_name;
+    std::string subsystem;
+    virtual ~LegacyBlock() {};
+};
+
+struct LegacyOperationBlock: LegacyBlock
+{
+    std::string inputs;
+    std::vector<std::weak_ptr<LegacyBlock>> in_ports;
+    double gain;
+};
+
+struct LegacyConstantBlock: LegacyBlock
+{
+    std::vector<double> value;
+};
+
+struct LegacyUnitDelayBlock: LegacyBlock
+{
+    std::weak_ptr<LegacyBlock> input;
+};
+
+using LegacyResult = std::unordered_map<size_t, std::shared_ptr<LegacyBlock>>;
+
+LegacyResult legacy_copy(const generator::ParserResult& result)
+{
+    LegacyResult legacy_blocks;
+    for (const generator::BaseBlock* block: result.blocks)
+    {
+        std::shared_ptr<LegacyBlock> legacy_block;
+        if (generator::is_operation(block->type))
+        {
+            auto oper_block = std::make_shared<LegacyOperationBlock>();
+            const auto& in_ports = dynamic_cast<const generator::OperationBlock&>(*block).in_ports;
+            for (size_t port = 0; port < in_ports.declared; ++port)
+                oper_block->inputs += in_ports.is_inverted(port) ? '-' : '+';
+            oper_block->gain = dynamic_cast<const generator::OperationBlock&>(*block).gain;
+            legacy_block = oper_block;
+        }
+        else if (block->type == generator::BlockType::CONSTANT)
+        {
+            auto constant_block = std::make_shared<LegacyConstantBlock>();
+            constant_block->value = dynamic_cast<const generator::ConstantBlock&>(*block).value;
+            legacy_block = constant_block;
+        }
+        else if (block->type == generator::BlockType::UNIT_DELAY)
+        {
+            legacy_block = std::make_shared<LegacyUnitDelayBlock>();
+        }
+        else
+        {
+            legacy_block = std::make_shared<LegacyBlock>();
+        }
+        legacy_block->name = generator::block_name(*block, result.names);
+        legacy_block->type = block->type;
+        legacy_block->is_port = block->is_port;
+        legacy_block->sid = block->sid;
+        legacy_block->width = block->width;
+        legacy_block->sample_time = block->sample_time;
+        legacy_block->port_name = result.names[block->port_name];
+        legacy_block->subsystem = result.names[block->subsystem];
+        legacy_blocks.insert({block->sid, legacy_block});
+    }
+
+    for (const generator::BaseBlock* block: result.blocks)
+    {
+        const auto& legacy_block = legacy_blocks[block->sid];
+        if (generator::is_operation(block->type))
+        {
+            auto& legacy_in_ports = std::dynamic_pointer_cast<LegacyOperationBlock>(legacy_block)->in_ports;
+            for (const generator::BaseBlock* input: dynamic_cast<const generator::OperationBlock&>(*block).in_ports)
+            {
+                legacy_in_ports.push_back(legacy_blocks[input->sid]);
+                legacy_blocks[input->sid]->next_blocks.push_back(legacy_block);
+            }
+        }
+        else if (block->type == generator::BlockType::UNIT_DELAY)
+        {
+            const generator::BaseBlock* input = dynamic_cast<const generator::UnitDelayBlock&>(*block).input;
+            std::dynamic_pointer_cast<LegacyUnitDelayBlock>(legacy_block)->input = legacy_blocks[input->sid];
+            legacy_blocks[input->sid]->next_blocks.push_back(legacy_block);
+        }
+    }
+    for (auto& [_, legacy_block]: legacy_blocks)
+        legacy_block->next_blocks.shrink_to_fit();
+    return legacy_blocks;
+}
+}
+
+void* operator new(size_t size)
+{
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (!ptr)
+        throw std::bad_alloc();
+    live_bytes += malloc_usable_size(ptr);
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (!ptr)
+        return;
+    live_bytes -= malloc_usable_size(ptr);
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+int main(int argc, char** argv)
+{
+    //usage: block_memory_test [loops count]
+    size_t loops_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    write_loops_model("block_memory_test.xml", loops_count);
+
+    generator::Parser parser("block_memory_test.xml");
+    size_t document_bytes = live_bytes;
+    generator::ParserResult result = parser.parse();
+    size_t compact_bytes = live_bytes - document_bytes;
+
+    LegacyResult legacy_result = legacy_copy(result);
+    size_t legacy_bytes = live_bytes - document_bytes - compact_bytes;
+
+    double blocks_count = static_cast<double>(result.blocks.size());
+    double shrink = static_cast<double>(legacy_bytes) / compact_bytes;
+    std::printf("blocks: %zu, names: %zu\n", result.blocks.size(), result.names.size());
+    std::printf("compact: %.1f bytes per block\n", compact_bytes / blocks_count);
+    std::printf("legacy: %.1f bytes per block\n", legacy_bytes / blocks_count);
+    std::printf("shrink: %.2fx\n", shrink);
+    std::remove("block_memory_test.xml");
+    return shrink >= 4 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include <parser.h>
+#include <generator.h>
+#include "test_models.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <sstream>
+
+//generates chunked code for a model, then for the model with one gain retuned and with the last loop removed;
+//fails if retuning rewrites anything but one chunk, removing rewrites more than a few files
+//or code differs from code generated without previous run
+
+namespace
+{
+const std::string file_name = "incremental_output_test";
+
+//kept cache, if any, is used the way watch mode keeps it between saves
+void generate(size_t loops_count, size_t retuned_loop, generator::ChunkCache* kept_cache = nullptr)
+{
+    write_loops_model(file_name + ".xml", loops_count, retuned_loop);
+    generator::GeneratorOptions options;
+    options.output_chunk_blocks = 16;
+    //gains of loops share levels, so chunks also get gain groups
+    options.gain_group_min_size = 2;
+    generator::Parser parser(file_name + ".xml");
+    generator::Generator code_generator(parser.parse(), options);
+    code_generator.keep_chunk_cache(kept_cache);
+    code_generator.generate_code("nwocg", file_name);
+}
+
+//name - code of every generated source file
+std::map<std::string, std::string> generated_files()
+{
+    std::map<std::string, std::string> files;
+    for (const auto& entry: std::filesystem::directory_iterator("."))
+    {
+        std::string name = entry.path().filename().string();
+        //test executable has the same prefix, so only sources are taken
+        bool is_source = entry.path().extension() == ".c" || entry.path().extension() == ".h";
+        if (name.rfind(file_name, 0) != 0 || !is_source)
+            continue;
+        std::ifstream fin(entry.path(), std::ios::binary);
+        std::ostringstream code;
+        code << fin.rdbuf();
+        files[name] = code.str();
+    }
+    return files;
+}
+
+void remove_generated_files()
+{
+    for (const auto& [name, _]: generated_files())
+        std::filesystem::remove(name);
+    std::filesystem::remove(file_name + ".cache");
+}
+
+std::map<std::string, std::string> generate_from_scratch(size_t loops_count, size_t retuned_loop)
+{
+    remove_generated_files();
+    generate(loops_count, retuned_loop);
+    return generated_files();
+}
+}
+
+int main()
+{
+    const size_t loops_count = 2000;
+    const size_t retuned_loop = 1000;
+    auto retuned_reference = generate_from_scratch(loops_count, retuned_loop);
+    auto removed_reference = generate_from_scratch(loops_count - 1, SIZE_MAX);
+    auto reference = generate_from_scratch(loops_count, SIZE_MAX);
+
+    remove_generated_files();
+    generate(loops_count, SIZE_MAX);
+    size_t files_count = generated_files().size();
+
+    //files left alone keep modification time set here
+    auto past = std::filesystem::file_time_type::clock::now() - std::chrono::hours(1);
+    auto generate_again = [&past](size_t loops_count, size_t retuned_loop, generator::ChunkCache* kept_cache = nullptr)
+    {
+        for (const auto& [name, _]: generated_files())
+            std::filesystem::last_write_time(name, past);
+        generate(loops_count, retuned_loop, kept_cache);
+        size_t rewritten_count = 0;
+        for (const auto& [name, _]: generated_files())
+            rewritten_count += std::filesystem::last_write_time(name) != past ? 1 : 0;
+        return rewritten_count;
+    };
+
+    size_t rewritten_count = generate_again(loops_count, retuned_loop);
+    bool is_same = generated_files() == retuned_reference;
+    std::printf("retuned gain: %zu of %zu files rewritten, %s\n", rewritten_count, files_count, is_same ? "same" : "DIFFERENT");
+    int failures = rewritten_count == 1 && is_same ? 0 : 1;
+
+    //sids of all nested blocks shift, but blocks are matched by paths, so only files around the loop and main file change
+    rewritten_count = generate_again(loops_count - 1, SIZE_MAX);
+    is_same = generated_files() == removed_reference;
+    std::printf("removed loop: %zu of %zu files rewritten, %s\n", rewritten_count, files_count, is_same ? "same" : "DIFFERENT");
+    failures += rewritten_count <= 10 && is_same ? 0 : 1;
+
+    //a run without the kept cache changes files behind it, so the kept cache must not be trusted then
+    generator::ChunkCache kept_cache;
+    generate(loops_count, SIZE_MAX, &kept_cache);
+    generate(loops_count, retuned_loop);
+    generate(loops_count, SIZE_MAX, &kept_cache);
+    is_same = generated_files() == reference;
+    rewritten_count = generate_again(loops_count, retuned_loop, &kept_cache);
+    is_same = is_same && generated_files() == retuned_reference;
+    std::printf("kept cache: %zu of %zu files rewritten, %s\n", rewritten_count, files_count, is_same ? "same" : "DIFFERENT");
+    failures += rewritten_count == 1 && is_same ? 0 : 1;
+
+    remove_generated_files();
+    std::filesystem::remove(file_name + ".xml");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#include <parser.h>
+#include <generator.h>
+#include "test_models.h"
+
+#include <cstdio>
+#include <sstream>
+
+//generates code for a model with nested subsystems several times, parsing it on one and on several threads;
+//fails if generated files differ in any byte
+
+namespace
+{
+std::string generate(int parse_threads, const generator::GeneratorOptions& options)
+{
+    //generator leaves an unchanged file alone, so every run starts without one
+    std::remove("reproducible_output_test.c");
+    generator::Parser parser("reproducible_output_test.xml", parse_threads);
+    generator::Generator code_generator(parser.parse(), options);
+    code_generator.generate_code("nwocg", "reproducible_output_test");
+
+    std::ifstream fin("reproducible_output_test.c", std::ios::binary);
+    std::ostringstream code;
+    code << fin.rdbuf();
+    return code.str();
+}
+}
+
+int main()
+{
+    //large enough to be cut into several chunks by a parallel parse
+    write_loops_model("reproducible_output_test.xml", 3000);
+
+    generator::GeneratorOptions inlined_options;
+    generator::GeneratorOptions shared_options;
+    shared_options.subsystem_function_min_blocks = 4;
+    shared_options.share_identical_subsystems = true;
+    shared_options.gain_group_min_size = 2;
+
+    int failures = 0;
+    for (const auto& [options_name, options]: {std::make_pair("inlined subsystems", inlined_options),
+                                               std::make_pair("shared subsystem functions", shared_options)})
+    {
+        std::string reference = generate(1, options);
+        for (int parse_threads: {1, 2, 4})
+        {
+            bool is_same = generate(parse_threads, options) == reference;
+            std::printf("%s, %d parse threads: %s\n", options_name, parse_threads, is_same ? "same" : "DIFFERENT");
+            failures += is_same ? 0 : 1;
+        }
+    }
+
+    std::remove("reproducible_output_test.xml");
+    std::remove("reproducible_output_test.c");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include <parser.h>
+#include <generator.h>
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <vector>
+
+//generates code for small models, each one a case that was once generated or parsed wrong;
+//fails if code of a case misses what it should have or a model isn't rejected with the expected error
+
+namespace
+{
+struct ModelCase
+{
+    std::string name;
+    std::string model; //blocks and lines of the root system
+    generator::GeneratorOptions options;
+    std::function<bool(const std::string&)> check; //checks generated code, empty if model must be rejected
+    std::string error; //part of the expected error message
+};
+
+//text between the opening and closing braces of a generated function, empty if there is no such function
+std::string function_body(const std::string& code, const std::string& function_name)
+{
+    size_t begin = code.find(function_name + "()\n{\n");
+    if (begin == std::string::npos)
+        return "";
+    begin = code.find('{', begin) + 1;
+    return code.substr(begin, code.find("\n}", begin) - begin);
+}
+
+bool contains(const std::string& text, const std::string& part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+//returns an empty string on success and the reason of failure otherwise
+std::string run_case(const ModelCase& model_case)
+{
+    {
+        std::ofstream fout("small_models_test.xml");
+        fout << "<?xml version=\"1.0\"?>\n<System>\n" << model_case.model << "</System>\n";
+    }
+    std::remove("small_models_test.c");
+    try
+    {
+        generator::Parser parser("small_models_test.xml");
+        generator::Generator code_generator(parser.parse(), model_case.options);
+        code_generator.generate_code("nwocg", "small_models_test");
+    }
+    catch (const std::exception& e)
+    {
+        if (!model_case.check && contains(e.what(), model_case.error))
+            return "";
+        return std::string("unexpected error: ") + e.what();
+    }
+    if (!model_case.check)
+        return "model isn't rejected";
+
+    std::ifstream fin("small_models_test.c", std::ios::binary);
+    std::ostringstream code;
+    code << fin.rdbuf();
+    return model_case.check(code.str()) ? "" : "generated code:\n" + code.str();
+}
+
+std::vector<ModelCase> model_cases()
+{
+    std::vector<ModelCase> cases;
+
+    //s reads a base rate signal without sample time and a slow delay, so it must be computed every base step
+    cases.push_back({"base rate input without sample time",
+                     "<Block BlockType=\"Inport\" Name=\"u\" SID=\"1\"><Port><P Name=\"Name\">u</P></Port></Block>\n"
+                     "<Block BlockType=\"Gain\" Name=\"g\" SID=\"2\"><P Name=\"Gain\">2</P></Block>\n"
+                     "<Block BlockType=\"UnitDelay\" Name=\"d\" SID=\"3\"><P Name=\"SampleTime\">0.01</P></Block>\n"
+                     "<Block BlockType=\"Sum\" Name=\"s\" SID=\"4\"><P Name=\"Inputs\">++</P><Port><P Name=\"Name\">y</P></Port></Block>\n"
+                     "<Block BlockType=\"Gain\" Name=\"f\" SID=\"5\"><P Name=\"Gain\">3</P><P Name=\"SampleTime\">0.001</P>"
+                     "<Port><P Name=\"Name\">yf</P></Port></Block>\n"
+                     "<Line><P Name=\"Src\">1#out:1</P><Branch><P Name=\"Dst\">2#in:1</P></Branch><Branch><P Name=\"Dst\">5#in:1</P></Branch></Line>\n"
+                     "<Line><P Name=\"Src\">2#out:1</P><P Name=\"Dst\">4#in:1</P></Line>\n"
+                     "<Line><P Name=\"Src\">3#out:1</P><P Name=\"Dst\">4#in:2</P></Line>\n"
+                     "<Line><P Name=\"Src\">4#out:1</P><P Name=\"Dst\">3#in:1</P></Line>\n",
+                     generator::GeneratorOptions(),
+                     [](const std::string& code) { return contains(function_body(code, "nwocg_rate0_output"), "nwocg.s = "); },
+                     ""});
+
+    //X closes a path from one output of S to another input of S, which isn't a loop unless S is called as one function
+    generator::GeneratorOptions function_options;
+    function_options.subsystem_function_min_blocks = 1;
+    cases.push_back({"path through kept subsystem",
+                     "<Block BlockType=\"Inport\" Name=\"u\" SID=\"1\"><Port><P Name=\"Name\">u</P></Port></Block>\n"
+                     "<Block BlockType=\"SubSystem\" Name=\"S\" SID=\"2\"><System>\n"
+                     "<Block BlockType=\"Inport\" Name=\"in1\" SID=\"1\"/>\n"
+                     "<Block BlockType=\"Inport\" Name=\"in2\" SID=\"2\"><P Name=\"Port\">2</P></Block>\n"
+                     "<Block BlockType=\"Gain\" Name=\"G1\" SID=\"3\"><P Name=\"Gain\">2</P></Block>\n"
+                     "<Block BlockType=\"Gain\" Name=\"G2\" SID=\"4\"><P Name=\"Gain\">3</P><Port><P Name=\"Name\">y</P></Port></Block>\n"
+                     "<Block BlockType=\"Outport\" Name=\"out1\" SID=\"5\"/>\n"
+                     "<Block BlockType=\"Outport\" Name=\"out2\" SID=\"6\"><P Name=\"Port\">2</P></Block>\n"
+                     "<Line><P Name=\"Src\">1#out:1</P><P Name=\"Dst\">3#in:1</P></Line>\n"
+                     "<Line><P Name=\"Src\">2#out:1</P><P Name=\"Dst\">4#in:1</P></Line>\n"
+                     "<Line><P Name=\"Src\">3#out:1</P><P Name=\"Dst\">5#in:1</P></Line>\n"
+                     "<Line><P Name=\"Src\">4#out:1</P><P Name=\"Dst\">6#in:1</P></Line>\n"
+                     "</System></Block>\n"
+                     "<Block BlockType=\"Gain\" Name=\"X\" SID=\"3\"><P Name=\"Gain\">4</P></Block>\n"
+                     "<Block BlockType=\"Outport\" Name=\"y\" SID=\"4\"/>\n"
+                     "<Line><P Name=\"Src\">1#out:1</P><P Name=\"Dst\">2#in:1</P></Line>\n"
+                     "<Line><P Name=\"Src\">2#out:1</P><P Name=\"Dst\">3#in:1</P></Line>\n"
+                     "<Line><P Name=\"Src\">3#out:1</P><P Name=\"Dst\">2#in:2</P></Line>\n"
+                     "<Line><P Name=\"Src\">2#out:2</P><P Name=\"Dst\">4#in:1</P></Line>\n",
+                     function_options,
+                     [](const std::string& code) { return contains(code, "nwocg.X = ") && !contains(code, "_output(&nwocg.S"); },
+                     ""});
+
+    //inner inport goes straight to outport and the outport back to the inport, so the signal has no source
+    cases.push_back({"wire loop through subsystem",
+                     "<Block BlockType=\"SubSystem\" Name=\"S\" SID=\"1\"><System>\n"
+                     "<Block BlockType=\"Inport\" Name=\"in1\" SID=\"1\"/>\n"
+                     "<Block BlockType=\"Outport\" Name=\"out1\" SID=\"2\"/>\n"
+                     "<Line><P Name=\"Src\">1#out:1</P><P Name=\"Dst\">2#in:1</P></Line>\n"
+                     "</System></Block>\n"
+                     "<Block BlockType=\"Gain\" Name=\"G\" SID=\"2\"><P Name=\"Gain\">2</P><Port><P Name=\"Name\">y</P></Port></Block>\n"
+                     "<Line><P Name=\"Src\">1#out:1</P><Branch><P Name=\"Dst\">1#in:1</P></Branch><Branch><P Name=\"Dst\">2#in:1</P></Branch></Line>\n",
+                     generator::GeneratorOptions(), nullptr, "wire loop"});
+
+    //only the first number of a value was read, so an expression or a fraction passed as a smaller valid value
+    const std::string gain_model = "<Block BlockType=\"Inport\" Name=\"u\" SID=\"1\"><Port><P Name=\"Name\">u</P></Port></Block>\n"
+                                   "<Block BlockType=\"Gain\" Name=\"G\" SID=\"2\"><P Name=\"Gain\">%GAIN%</P><Port><P Name=\"Name\">y</P></Port></Block>\n"
+                                   "<Line><P Name=\"Src\">1#out:%PORT%</P><P Name=\"Dst\">2#in:1</P></Line>\n";
+    auto gain_case = [&gain_model](const std::string& gain, const std::string& port)
+    {
+        std::string model = gain_model;
+        model.replace(model.find("%GAIN%"), 6, gain);
+        model.replace(model.find("%PORT%"), 6, port);
+        return model;
+    };
+    cases.push_back({"gain expression", gain_case("3*Kp", "1"), generator::GeneratorOptions(), nullptr, "Gain isn't a number"});
+    cases.push_back({"fractional port", gain_case("3", "1.5"), generator::GeneratorOptions(), nullptr, "isn't a non-negative integer"});
+    cases.push_back({"gain with spaces around", gain_case(" 3 ", "1"), generator::GeneratorOptions(),
+                     [](const std::string& code) { return contains(code, "nwocg.G = nwocg.u * 3;"); }, ""});
+
+    //port numbers were narrowed to 8 bits, so a line into port 257 wired port 1
+    cases.push_back({"port above 8 bits",
+                     "<Block BlockType=\"Inport\" Name=\"u\" SID=\"1\"><Port><P Name=\"Name\">u</P></Port></Block>\n"
+                     "<Block BlockType=\"Sum\" Name=\"s\" SID=\"2\"><P Name=\"Inputs\">++</P><Port><P Name=\"Name\">y</P></Port></Block>\n"
+                     "<Line><P Name=\"Src\">1#out:1</P><Branch><P Name=\"Dst\">2#in:257</P></Branch><Branch><P Name=\"Dst\">2#in:2</P></Branch></Line>\n",
+                     generator::GeneratorOptions(), nullptr, "line goes to port 257"});
+    cases.push_back({"port above limit", gain_case("3", "70000"), generator::GeneratorOptions(), nullptr, "above port limit"});
+
+    return cases;
+}
+}
+
+int main()
+{
+    int failures = 0;
+    for (const auto& model_case: model_cases())
+    {
+        std::string failure = run_case(model_case);
+        std::printf("%s: %s\n", model_case.name.c_str(), failure.empty() ? "ok" : failure.c_str());
+        failures += failure.empty() ? 0 : 1;
+    }
+
+    std::remove("small_models_test.xml");
+    std::remove("small_models_test.c");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+//model of loops sharing an input; every loop is a subsystem with a nested PI subsystem, its output is an external port;
+//retuned loop, if any, has another proportional gain
+inline void write_loops_model(const std::string& path, size_t loops_count, size_t retuned_loop = SIZE_MAX)
+{
+    std::ofstream fout(path);
+    fout << "<?xml version=\"1.0\"?>\n<System>\n";
+    fout << "<Block BlockType=\"Inport\" Name=\"u\" SID=\"1\"><Port><P Name=\"Name\">u</P></Port></Block>\n";
+    for (size_t i = 0; i < loops_count; ++i)
+    {
+        std::string loop_sid = std::to_string(2 + 2 * i);
+        std::string out_sid = std::to_string(3 + 2 * i);
+        fout << "<Block BlockType=\"SubSystem\" Name=\"Loop " << i << "\" SID=\"" << loop_sid << "\"><System>\n"
+             << "<Block BlockType=\"Inport\" Name=\"u\" SID=\"1\"/>\n"
+             << "<Block BlockType=\"Constant\" Name=\"Setpoint\" SID=\"2\"><P Name=\"Value\">" << i << "</P></Block>\n"
+             << "<Block BlockType=\"Sum\" Name=\"Error\" SID=\"3\"><P Name=\"Inputs\">+-</P></Block>\n"
+             << "<Block BlockType=\"SubSystem\" Name=\"PI\" SID=\"4\"><System>\n"
+             << "<Block BlockType=\"Inport\" Name=\"e\" SID=\"1\"/>\n"
+             << "<Block BlockType=\"Gain\" Name=\"P\" SID=\"2\"><P Name=\"Gain\">" << (i == retuned_loop ? 4 : 3) << "</P></Block>\n"
+             << "<Block BlockType=\"Gain\" Name=\"I\" SID=\"3\"><P Name=\"Gain\">0.5</P></Block>\n"
+             << "<Block BlockType=\"Sum\" Name=\"Integrator\" SID=\"4\"/>\n"
+             << "<Block BlockType=\"UnitDelay\" Name=\"State\" SID=\"5\"/>\n"
+             << "<Block BlockType=\"Sum\" Name=\"Output\" SID=\"6\"><Port><P Name=\"Name\">y" << i << "</P></Port></Block>\n"
+             << "<Block BlockType=\"Outport\" Name=\"y\" SID=\"7\"/>\n"
+             << "<Line><P Name=\"Src\">1#out:1</P><Branch><P Name=\"Dst\">2#in:1</P></Branch><Branch><P Name=\"Dst\">3#in:1</P></Branch></Line>\n"
+             << "<Line><P Name=\"Src\">3#out:1</P><P Name=\"Dst\">4#in:1</P></Line>\n"
+             << "<Line><P Name=\"Src\">5#out:1</P><P Name=\"Dst\">4#in:2</P></Line>\n"
+             << "<Line><P Name=\"Src\">4#out:1</P><Branch><P Name=\"Dst\">5#in:1</P></Branch><Branch><P Name=\"Dst\">6#in:2</P></Branch></Line>\n"
+             << "<Line><P Name=\"Src\">2#out:1</P><P Name=\"Dst\">6#in:1</P></Line>\n"
+             << "<Line><P Name=\"Src\">6#out:1</P><P Name=\"Dst\">7#in:1</P></Line>\n"
+             << "</System></Block>\n"
+             << "<Block BlockType=\"Outport\" Name=\"y\" SID=\"5\"/>\n"
+             << "<Line><P Name=\"Src\">2#out:1</P><P Name=\"Dst\">3#in:1</P></Line>\n"
+             << "<Line><P Name=\"Src\">1#out:1</P><P Name=\"Dst\">3#in:2</P></Line>\n"
+             << "<Line><P Name=\"Src\">3#out:1</P><P Name=\"Dst\">4#in:1</P></Line>\n"
+             << "<Line><P Name=\"Src\">4#out:1</P><P Name=\"Dst\">5#in:1</P></Line>\n"
+             << "</System></Block>\n";
+        fout << "<Block BlockType=\"Outport\" Name=\"y" << i << "\" SID=\"" << out_sid << "\"/>\n";
+        fout << "<Line><P Name=\"Src\">1#out:1</P><P Name=\"Dst\">" << loop_sid << "#in:1</P></Line>\n";
+        fout << "<Line><P Name=\"Src\">" << loop_sid << "#out:1</P><P Name=\"Dst\">" << out_sid << "#in:1</P></Line>\n";
+    }
+    fout << "</System>\n";
+}
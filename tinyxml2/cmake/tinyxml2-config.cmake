@@ -21,6 +21,9 @@ if (tinyxml2_comp_static AND tinyxml2_comp_shared)
     return()
 endif ()
 
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)
+
 set(tinyxml2_static_targets "${CMAKE_CURRENT_LIST_DIR}/tinyxml2-static-targets.cmake")
 set(tinyxml2_shared_targets "${CMAKE_CURRENT_LIST_DIR}/tinyxml2-shared-targets.cmake")
 
@@ -100,6 +100,35 @@ distribution.
 	#define TIXML_SSCANF   sscanf
 #endif
 
+// SSE2 is part of x86-64, AVX2 is picked at run time. Define TINYXML2_NO_SIMD to use the plain loops.
+#if !defined(TINYXML2_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+	#define TIXML_SIMD_X86
+	#include <immintrin.h>
+	#include <stdint.h>
+#endif
+
+// Numbers are read with std::from_chars where the library has it, which is locale independent.
+#if defined(__has_include) && ( __cplusplus >= 201703L || ( defined(_MSVC_LANG) && _MSVC_LANG >= 201703L ) )
+	#if __has_include(<charconv>)
+		#include <charconv>
+		#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+			#define TIXML_FROM_CHARS
+		#endif
+	#endif
+#endif
+#ifndef TIXML_FROM_CHARS
+	#include <errno.h>
+#endif
+
+// XMLDocument::SetParseThreads() uses std::thread. Define TINYXML2_NO_THREADS to always parse on the calling thread.
+#if !defined(TINYXML2_NO_THREADS) && ( __cplusplus >= 201103L || ( defined(_MSVC_LANG) && _MSVC_LANG >= 201103L ) )
+	#define TIXML_THREADS
+	#include <atomic>
+	#include <condition_variable>
+	#include <mutex>
+	#include <thread>
+#endif
+
 #if defined(_WIN64)
 	#define TIXML_FSEEK _fseeki64
 	#define TIXML_FTELL _ftelli64
@@ -149,6 +178,159 @@ static const Entity entities[NUM_ENTITIES] = {
 };
 
 
+
+// Scanners used by the parser's inner loops. Each vector version starts from the aligned
+// block containing p and masks off the bytes before it: an aligned load never crosses into
+// the next page, so reading past the terminating null is safe. AddressSanitizer can't know
+// that, so it doesn't check these loads. Neither does ThreadSanitizer: in a parallel parse the
+// masked bytes may belong to the chunk of another thread.
+#ifdef TIXML_SIMD_X86
+
+#define TIXML_VECTOR_SCAN __attribute__(( no_sanitize_address, no_sanitize_thread ))
+
+static inline int CountLineFeeds( unsigned lineFeeds, unsigned end )
+{
+    // Line feeds before the bit 'end'.
+    return __builtin_popcount( end < 32 ? lineFeeds & ( ( 1u << end ) - 1 ) : lineFeeds );
+}
+
+TIXML_VECTOR_SCAN
+static const char* FindCharSSE2( const char* p, char a, char b )
+{
+    const __m128i va = _mm_set1_epi8( a );
+    const __m128i vb = _mm_set1_epi8( b );
+    const __m128i vz = _mm_setzero_si128();
+    const char* block = reinterpret_cast<const char*>( reinterpret_cast<uintptr_t>( p ) & ~uintptr_t( 15 ) );
+    unsigned skip = static_cast<unsigned>( p - block );
+    for ( ;; block += 16, skip = 0 ) {
+        const __m128i v = _mm_load_si128( reinterpret_cast<const __m128i*>( block ) );
+        const __m128i hits = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( v, va ), _mm_cmpeq_epi8( v, vb ) ), _mm_cmpeq_epi8( v, vz ) );
+        const unsigned mask = ( static_cast<unsigned>( _mm_movemask_epi8( hits ) ) >> skip ) << skip;
+        if ( mask ) {
+            return block + __builtin_ctz( mask );
+        }
+    }
+}
+
+TIXML_VECTOR_SCAN
+static const char* SkipWhiteSpaceSSE2( const char* p, int* curLineNumPtr )
+{
+    // Whitespace is ' ' or 9..13, the latter tested as unsigned (c - 9) <= 4.
+    const __m128i space = _mm_set1_epi8( ' ' );
+    const __m128i lineFeed = _mm_set1_epi8( '\n' );
+    const __m128i tab = _mm_set1_epi8( '\t' );
+    const __m128i four = _mm_set1_epi8( 4 );
+    const char* block = reinterpret_cast<const char*>( reinterpret_cast<uintptr_t>( p ) & ~uintptr_t( 15 ) );
+    unsigned skip = static_cast<unsigned>( p - block );
+    for ( ;; block += 16, skip = 0 ) {
+        const __m128i v = _mm_load_si128( reinterpret_cast<const __m128i*>( block ) );
+        const __m128i control = _mm_sub_epi8( v, tab );
+        const __m128i isControl = _mm_cmpeq_epi8( _mm_min_epu8( control, four ), control );
+        const unsigned white = static_cast<unsigned>( _mm_movemask_epi8( _mm_or_si128( isControl, _mm_cmpeq_epi8( v, space ) ) ) );
+        const unsigned lineFeeds = ( static_cast<unsigned>( _mm_movemask_epi8( _mm_cmpeq_epi8( v, lineFeed ) ) ) >> skip ) << skip;
+        const unsigned other = ( ( ~white & 0xffffu ) >> skip ) << skip;
+        if ( other ) {
+            const unsigned end = static_cast<unsigned>( __builtin_ctz( other ) );
+            if ( curLineNumPtr ) {
+                *curLineNumPtr += CountLineFeeds( lineFeeds, end );
+            }
+            return block + end;
+        }
+        if ( curLineNumPtr ) {
+            *curLineNumPtr += CountLineFeeds( lineFeeds, 32 );
+        }
+    }
+}
+
+TIXML_VECTOR_SCAN __attribute__(( target( "avx2" ) ))
+static const char* FindCharAVX2( const char* p, char a, char b )
+{
+    const __m256i va = _mm256_set1_epi8( a );
+    const __m256i vb = _mm256_set1_epi8( b );
+    const __m256i vz = _mm256_setzero_si256();
+    const char* block = reinterpret_cast<const char*>( reinterpret_cast<uintptr_t>( p ) & ~uintptr_t( 31 ) );
+    unsigned skip = static_cast<unsigned>( p - block );
+    for ( ;; block += 32, skip = 0 ) {
+        const __m256i v = _mm256_load_si256( reinterpret_cast<const __m256i*>( block ) );
+        const __m256i hits = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( v, va ), _mm256_cmpeq_epi8( v, vb ) ), _mm256_cmpeq_epi8( v, vz ) );
+        const unsigned mask = ( static_cast<unsigned>( _mm256_movemask_epi8( hits ) ) >> skip ) << skip;
+        if ( mask ) {
+            return block + __builtin_ctz( mask );
+        }
+    }
+}
+
+TIXML_VECTOR_SCAN __attribute__(( target( "avx2" ) ))
+static const char* SkipWhiteSpaceAVX2( const char* p, int* curLineNumPtr )
+{
+    const __m256i space = _mm256_set1_epi8( ' ' );
+    const __m256i lineFeed = _mm256_set1_epi8( '\n' );
+    const __m256i tab = _mm256_set1_epi8( '\t' );
+    const __m256i four = _mm256_set1_epi8( 4 );
+    const char* block = reinterpret_cast<const char*>( reinterpret_cast<uintptr_t>( p ) & ~uintptr_t( 31 ) );
+    unsigned skip = static_cast<unsigned>( p - block );
+    for ( ;; block += 32, skip = 0 ) {
+        const __m256i v = _mm256_load_si256( reinterpret_cast<const __m256i*>( block ) );
+        const __m256i control = _mm256_sub_epi8( v, tab );
+        const __m256i isControl = _mm256_cmpeq_epi8( _mm256_min_epu8( control, four ), control );
+        const unsigned white = static_cast<unsigned>( _mm256_movemask_epi8( _mm256_or_si256( isControl, _mm256_cmpeq_epi8( v, space ) ) ) );
+        const unsigned lineFeeds = ( static_cast<unsigned>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( v, lineFeed ) ) ) >> skip ) << skip;
+        const unsigned other = ( ~white >> skip ) << skip;
+        if ( other ) {
+            const unsigned end = static_cast<unsigned>( __builtin_ctz( other ) );
+            if ( curLineNumPtr ) {
+                *curLineNumPtr += CountLineFeeds( lineFeeds, end );
+            }
+            return block + end;
+        }
+        if ( curLineNumPtr ) {
+            *curLineNumPtr += CountLineFeeds( lineFeeds, 32 );
+        }
+    }
+}
+
+// The CPU is probed once by the runtime before any constructor runs, so checking is a load and a test.
+static const char* FindChar( const char* p, char a, char b )
+{
+    return __builtin_cpu_supports( "avx2" ) ? FindCharAVX2( p, a, b ) : FindCharSSE2( p, a, b );
+}
+
+static const char* SkipWhiteSpaceVector( const char* p, int* curLineNumPtr )
+{
+    return __builtin_cpu_supports( "avx2" ) ? SkipWhiteSpaceAVX2( p, curLineNumPtr ) : SkipWhiteSpaceSSE2( p, curLineNumPtr );
+}
+
+#else
+
+// First of a, b or the terminating null.
+static const char* FindChar( const char* p, char a, char b )
+{
+    while ( *p && *p != a && *p != b ) {
+        ++p;
+    }
+    return p;
+}
+
+static const char* SkipWhiteSpaceVector( const char* p, int* curLineNumPtr )
+{
+    while( XMLUtil::IsWhiteSpace( *p ) ) {
+        if ( curLineNumPtr && *p == '\n' ) {
+            ++(*curLineNumPtr);
+        }
+        ++p;
+    }
+    return p;
+}
+
+#endif
+
+
+const char* XMLUtil::SkipWhiteSpaceRun( const char* p, int* curLineNumPtr )
+{
+    return SkipWhiteSpaceVector( p, curLineNumPtr );
+}
+
+
 StrPair::~StrPair()
 {
     Reset();
@@ -214,8 +396,8 @@ char* StrPair::ParseText( char* p, const char* endTag, int strFlags, int* curLin
     const char  endChar = *endTag;
     size_t length = strlen( endTag );
 
-    // Inner loop of text parsing.
-    while ( *p ) {
+    // Inner loop of text parsing: jump from one candidate end or line feed to the next.
+    for ( p = const_cast<char*>( FindChar( p, endChar, '\n' ) ); *p; p = const_cast<char*>( FindChar( p, endChar, '\n' ) ) ) {
         if ( *p == endChar && strncmp( p, endTag, length ) == 0 ) {
             Set( start, p, strFlags );
             return p + length;
@@ -229,7 +411,7 @@ char* StrPair::ParseText( char* p, const char* endTag, int strFlags, int* curLin
 }
 
 
-char* StrPair::ParseName( char* p )
+char* StrPair::ParseName( char* p, SymbolTable* symbols )
 {
     if ( !p || !(*p) ) {
         return 0;
@@ -244,11 +426,134 @@ char* StrPair::ParseName( char* p )
         ++p;
     }
 
+    if ( symbols ) {
+        // Point at the document's copy of the name; nothing to flush or delete.
+        const size_t len = static_cast<size_t>( p - start );
+        Reset();
+        _start = const_cast<char*>( symbols->Intern( start, len ) );
+        _end = _start + len;
+        return p;
+    }
     Set( start, p, 0 );
     return p;
 }
 
 
+const char* SymbolTable::Intern( const char* str, size_t len )
+{
+    TIXMLASSERT( str );
+    const unsigned hash = Hash( str, len );
+    size_t slot = Slot( str, len, hash );
+    if ( _capacity && _symbols[slot] ) {
+        return _symbols[slot];
+    }
+    // Keep at most half of the slots in use, so probe runs stay short.
+    if ( 2 * ( _size + 1 ) > _capacity ) {
+        Grow();
+        slot = Slot( str, len, hash );
+    }
+    char* symbol = new char[len+1];
+    memcpy( symbol, str, len );
+    symbol[len] = 0;
+    _symbols[slot] = symbol;
+    _hashes[slot] = hash;
+    ++_size;
+    return symbol;
+}
+
+
+const char* SymbolTable::Find( const char* str ) const
+{
+    TIXMLASSERT( str );
+    if ( !_capacity ) {
+        return 0;
+    }
+    const size_t len = strlen( str );
+    return _symbols[Slot( str, len, Hash( str, len ) )];
+}
+
+
+void SymbolTable::Merge( const SymbolTable& other )
+{
+    for( size_t i = 0; i < other._capacity; ++i ) {
+        if ( other._symbols[i] ) {
+            Intern( other._symbols[i], strlen( other._symbols[i] ) );
+        }
+    }
+}
+
+
+void SymbolTable::Clear()
+{
+    for( size_t i = 0; i < _capacity; ++i ) {
+        delete [] _symbols[i];
+    }
+    delete [] _symbols;
+    delete [] _hashes;
+    _symbols = 0;
+    _hashes = 0;
+    _capacity = 0;
+    _size = 0;
+}
+
+
+unsigned SymbolTable::Hash( const char* str, size_t len )
+{
+    // FNV-1a
+    unsigned hash = 2166136261u;
+    for( size_t i = 0; i < len; ++i ) {
+        hash ^= static_cast<unsigned char>( str[i] );
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+size_t SymbolTable::Slot( const char* str, size_t len, unsigned hash ) const
+{
+    // The slot holding the name, or the empty slot where it belongs.
+    if ( !_capacity ) {
+        return 0;
+    }
+    const size_t mask = _capacity - 1;
+    size_t slot = hash & mask;
+    while ( _symbols[slot] ) {
+        if ( _hashes[slot] == hash && strncmp( _symbols[slot], str, len ) == 0 && _symbols[slot][len] == 0 ) {
+            break;
+        }
+        slot = ( slot + 1 ) & mask;
+    }
+    return slot;
+}
+
+
+void SymbolTable::Grow()
+{
+    char** const oldSymbols = _symbols;
+    unsigned* const oldHashes = _hashes;
+    const size_t oldCapacity = _capacity;
+
+    _capacity = oldCapacity ? 2 * oldCapacity : 64;
+    _symbols = new char*[_capacity];
+    _hashes = new unsigned[_capacity];
+    memset( _symbols, 0, _capacity * sizeof( char* ) );
+
+    const size_t mask = _capacity - 1;
+    for( size_t i = 0; i < oldCapacity; ++i ) {
+        if ( oldSymbols[i] ) {
+            size_t slot = oldHashes[i] & mask;
+            while ( _symbols[slot] ) {
+                slot = ( slot + 1 ) & mask;
+            }
+            _symbols[slot] = oldSymbols[i];
+            _hashes[slot] = oldHashes[i];
+        }
+    }
+    delete [] oldSymbols;
+    delete [] oldHashes;
+}
+
+
 void StrPair::CollapseWhitespace()
 {
     // Adjusting _start would cause undefined behavior on delete[]
@@ -287,25 +592,35 @@ const char* StrPair::GetStr()
         _flags ^= NEEDS_FLUSH;
 
         if ( _flags ) {
+            // Characters to translate: '&' and CR, the latter also ending an LF-CR pair.
+            const char a = ( _flags & NEEDS_ENTITY_PROCESSING ) ? '&' : 0;
+            const char b = ( _flags & NEEDS_NEWLINE_NORMALIZATION ) ? CR : a;
             const char* p = _start;	// the read pointer
             char* q = _start;	// the write pointer
 
             while( p < _end ) {
-                if ( (_flags & NEEDS_NEWLINE_NORMALIZATION) && *p == CR ) {
+                // Copy the run up to the next character to translate in one go. The run ends
+                // at the null written to _end at the latest.
+                const char* run = p;
+                p = FindChar( p, a, b );
+                if ( q != run ) {
+                    memmove( q, run, p - run );
+                }
+                q += p - run;
+                if ( p >= _end ) {
+                    break;
+                }
+
+                if ( *p == CR ) {
                     // CR-LF pair becomes LF
                     // CR alone becomes LF
                     // LF-CR becomes LF
-                    if ( *(p+1) == LF ) {
-                        p += 2;
-                    }
-                    else {
+                    if ( p > run && *(p-1) == LF ) {
+                        // the LF is out already
                         ++p;
+                        continue;
                     }
-                    *q = LF;
-                    ++q;
-                }
-                else if ( (_flags & NEEDS_NEWLINE_NORMALIZATION) && *p == LF ) {
-                    if ( *(p+1) == CR ) {
+                    if ( *(p+1) == LF ) {
                         p += 2;
                     }
                     else {
@@ -314,7 +629,8 @@ const char* StrPair::GetStr()
                     *q = LF;
                     ++q;
                 }
-                else if ( (_flags & NEEDS_ENTITY_PROCESSING) && *p == '&' ) {
+                else {
+                    TIXMLASSERT( *p == '&' );
                     // Entities handled by tinyXML2:
                     // - special entities in the entity table [in/out]
                     // - numeric character reference [in]
@@ -354,16 +670,12 @@ const char* StrPair::GetStr()
                         }
                         if ( !entityFound ) {
                             // fixme: treat as error?
+                            *q = *p;
                             ++p;
                             ++q;
                         }
                     }
                 }
-                else {
-                    *q = *p;
-                    ++p;
-                    ++q;
-                }
             }
             *q = 0;
         }
@@ -379,6 +691,28 @@ const char* StrPair::GetStr()
 }
 
 
+#ifdef TINYXML2_STRING_VIEW
+std::string_view StrPair::GetView()
+{
+    TIXMLASSERT( _start );
+    TIXMLASSERT( _end );
+    if ( _flags & NEEDS_FLUSH ) {
+        // Text with nothing to translate is viewed where it lies. Dropping the
+        // processing flags leaves GetStr() just the terminator to write.
+        const size_t length = _end - _start;
+        if ( !( _flags & NEEDS_WHITESPACE_COLLAPSING )
+                && !( ( _flags & NEEDS_ENTITY_PROCESSING ) && memchr( _start, '&', length ) )
+                && !( ( _flags & NEEDS_NEWLINE_NORMALIZATION ) && memchr( _start, CR, length ) ) ) {
+            _flags &= ( NEEDS_FLUSH | NEEDS_DELETE );
+            return std::string_view( _start, length );
+        }
+    }
+    const char* str = GetStr();
+    return std::string_view( str, strlen( str ) );
+}
+#endif
+
+
 
 
 // --------- XMLUtil ----------- //
@@ -555,14 +889,230 @@ const char* XMLUtil::GetCharacterRef(const char* p, char* value, int* length)
     return p + 1;
 }
 
+
+// Where p[0, end) stops being well formed UTF-8, following the table of well formed byte sequences
+// in the Unicode standard (3.9, table 3-7). Null if it doesn't.
+static const char* FindInvalidUTF8Scalar( const char* p, const char* end )
+{
+    while ( p < end ) {
+        const unsigned char lead = static_cast<unsigned char>( *p );
+        if ( lead < 0x80 ) {
+#ifdef TIXML_SIMD_X86
+            while ( end - p >= 16 && !_mm_movemask_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) ) ) ) {
+                p += 16;
+            }
+            if ( p < end && static_cast<unsigned char>( *p ) < 0x80 ) {
+                ++p;
+            }
+#else
+            ++p;
+#endif
+            continue;
+        }
+        // The range of the second byte narrows for leads that could start an overlong form,
+        // a surrogate or a code point past U+10FFFF.
+        int length = 0;
+        unsigned char low = 0x80;
+        unsigned char high = 0xbf;
+        if ( lead >= 0xc2 && lead <= 0xdf ) {
+            length = 2;
+        }
+        else if ( lead >= 0xe0 && lead <= 0xef ) {
+            length = 3;
+            if ( lead == 0xe0 ) {
+                low = 0xa0;
+            }
+            else if ( lead == 0xed ) {
+                high = 0x9f;
+            }
+        }
+        else if ( lead >= 0xf0 && lead <= 0xf4 ) {
+            length = 4;
+            if ( lead == 0xf0 ) {
+                low = 0x90;
+            }
+            else if ( lead == 0xf4 ) {
+                high = 0x8f;
+            }
+        }
+        if ( length == 0 || end - p < length ) {
+            return p;
+        }
+        const unsigned char second = static_cast<unsigned char>( p[1] );
+        if ( second < low || second > high ) {
+            return p;
+        }
+        for ( int i = 2; i < length; ++i ) {
+            if ( ( static_cast<unsigned char>( p[i] ) & 0xc0 ) != 0x80 ) {
+                return p;
+            }
+        }
+        p += length;
+    }
+    return 0;
+}
+
+
+#ifdef TIXML_SIMD_X86
+
+// Keiser and Lemire's lookup algorithm ("Validating UTF-8 in less than one instruction per byte"),
+// as used by simdjson and simdutf. The high nibbles of a byte and of the byte before it and the
+// low nibble of the byte before index three tables; the AND of the results is nonzero for a bad
+// pair. Leads of three and four byte sequences are then checked to be followed by the right
+// number of continuations.
+__attribute__(( target( "avx2" ) ))
+static bool IsValidUTF8AVX2( const char* p, size_t size )
+{
+    static const unsigned char TOO_SHORT = 1 << 0;		// lead or ASCII followed by a lead or ASCII
+    static const unsigned char TOO_LONG = 1 << 1;		// ASCII followed by a continuation
+    static const unsigned char OVERLONG_3 = 1 << 2;
+    static const unsigned char TOO_LARGE = 1 << 3;
+    static const unsigned char SURROGATE = 1 << 4;
+    static const unsigned char OVERLONG_2 = 1 << 5;
+    static const unsigned char TOO_LARGE_1000 = 1 << 6;
+    static const unsigned char OVERLONG_4 = 1 << 6;
+    static const unsigned char TWO_CONTS = 1 << 7;		// continuation followed by a continuation
+    static const unsigned char CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+    static const unsigned char byte1High[16] = {
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+    };
+    static const unsigned char byte1Low[16] = {
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000
+    };
+    static const unsigned char byte2High[16] = {
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+    };
+    // A block whose last three bytes start a sequence the next block has to finish.
+    static const unsigned char incompleteBelow[32] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1
+    };
+
+    const __m256i table1High = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( byte1High ) ) );
+    const __m256i table1Low = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( byte1Low ) ) );
+    const __m256i table2High = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( byte2High ) ) );
+    const __m256i incomplete = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( incompleteBelow ) );
+    const __m256i nibble = _mm256_set1_epi8( 0x0f );
+    const __m256i thirdByte = _mm256_set1_epi8( 0xe0 - 0x80 );
+    const __m256i fourthByte = _mm256_set1_epi8( static_cast<char>( 0xf0 - 0x80 ) );
+    const __m256i highBit = _mm256_set1_epi8( static_cast<char>( 0x80 ) );
+
+    __m256i error = _mm256_setzero_si256();
+    __m256i previous = _mm256_setzero_si256();
+    __m256i previousIncomplete = _mm256_setzero_si256();
+    for ( size_t i = 0; i < size; i += 32 ) {
+        __m256i input;
+        if ( size - i >= 32 ) {
+            input = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( p + i ) );
+        }
+        else {
+            // The tail, padded with nulls, which are ASCII.
+            char tail[32] = { 0 };
+            memcpy( tail, p + i, size - i );
+            input = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( tail ) );
+        }
+        if ( _mm256_movemask_epi8( input ) ) {
+            const __m256i before = _mm256_permute2x128_si256( previous, input, 0x21 );
+            const __m256i prev1 = _mm256_alignr_epi8( input, before, 15 );
+            const __m256i prev2 = _mm256_alignr_epi8( input, before, 14 );
+            const __m256i prev3 = _mm256_alignr_epi8( input, before, 13 );
+            const __m256i special = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_shuffle_epi8( table1High, _mm256_and_si256( _mm256_srli_epi16( prev1, 4 ), nibble ) ),
+                    _mm256_shuffle_epi8( table1Low, _mm256_and_si256( prev1, nibble ) ) ),
+                _mm256_shuffle_epi8( table2High, _mm256_and_si256( _mm256_srli_epi16( input, 4 ), nibble ) ) );
+            // The high bit is set where the third or fourth byte of a sequence has to be.
+            const __m256i mustContinue = _mm256_and_si256(
+                _mm256_or_si256( _mm256_subs_epu8( prev2, thirdByte ), _mm256_subs_epu8( prev3, fourthByte ) ), highBit );
+            error = _mm256_or_si256( error, _mm256_xor_si256( mustContinue, special ) );
+        }
+        else {
+            error = _mm256_or_si256( error, previousIncomplete );
+        }
+        previousIncomplete = _mm256_subs_epu8( input, incomplete );
+        previous = input;
+    }
+    error = _mm256_or_si256( error, previousIncomplete );
+    return _mm256_testz_si256( error, error ) != 0;
+}
+
+#endif
+
+
+const char* XMLUtil::FindInvalidUTF8( const char* p, size_t size )
+{
+    TIXMLASSERT( p || size == 0 );
+#ifdef TIXML_SIMD_X86
+    // The vector check only says whether there is an error; finding it is left to the plain one.
+    if ( __builtin_cpu_supports( "avx2" ) && IsValidUTF8AVX2( p, size ) ) {
+        return 0;
+    }
+#endif
+    return FindInvalidUTF8Scalar( p, p + size );
+}
+
+#ifdef TIXML_FROM_CHARS
+// Writes v with to_chars, null terminated. False if it doesn't fit, and the caller falls back to
+// snprintf, which truncates. The arguments are those of the printf format each caller replaces.
+template<typename T, typename... Format>
+static bool ToChars( T v, char* buffer, int bufferSize, Format... format )
+{
+    if ( bufferSize <= 0 ) {
+        return false;
+    }
+    const std::to_chars_result result = std::to_chars( buffer, buffer + bufferSize - 1, v, format... );
+    if ( result.ec != std::errc() ) {
+        return false;
+    }
+    *result.ptr = 0;
+    return true;
+}
+#endif
+
+
 void XMLUtil::ToStr( int v, char* buffer, int bufferSize )
 {
+#ifdef TIXML_FROM_CHARS
+    if ( ToChars( v, buffer, bufferSize ) ) {
+        return;
+    }
+#endif
     TIXML_SNPRINTF( buffer, bufferSize, "%d", v );
 }
 
 
 void XMLUtil::ToStr( unsigned v, char* buffer, int bufferSize )
 {
+#ifdef TIXML_FROM_CHARS
+    if ( ToChars( v, buffer, bufferSize ) ) {
+        return;
+    }
+#endif
     TIXML_SNPRINTF( buffer, bufferSize, "%u", v );
 }
 
@@ -578,69 +1128,191 @@ void XMLUtil::ToStr( bool v, char* buffer, int bufferSize )
 */
 void XMLUtil::ToStr( float v, char* buffer, int bufferSize )
 {
+#ifdef TIXML_FROM_CHARS
+    // general with a precision prints as %g does
+    if ( ToChars( v, buffer, bufferSize, std::chars_format::general, 8 ) ) {
+        return;
+    }
+#endif
     TIXML_SNPRINTF( buffer, bufferSize, "%.8g", v );
 }
 
 
 void XMLUtil::ToStr( double v, char* buffer, int bufferSize )
 {
+#ifdef TIXML_FROM_CHARS
+    if ( ToChars( v, buffer, bufferSize, std::chars_format::general, 17 ) ) {
+        return;
+    }
+#endif
     TIXML_SNPRINTF( buffer, bufferSize, "%.17g", v );
 }
 
 
 void XMLUtil::ToStr( int64_t v, char* buffer, int bufferSize )
 {
+#ifdef TIXML_FROM_CHARS
+    if ( ToChars( v, buffer, bufferSize ) ) {
+        return;
+    }
+#endif
 	// horrible syntax trick to make the compiler happy about %lld
 	TIXML_SNPRINTF(buffer, bufferSize, "%lld", static_cast<long long>(v));
 }
 
 void XMLUtil::ToStr( uint64_t v, char* buffer, int bufferSize )
 {
+#ifdef TIXML_FROM_CHARS
+    if ( ToChars( v, buffer, bufferSize ) ) {
+        return;
+    }
+#endif
     // horrible syntax trick to make the compiler happy about %llu
     TIXML_SNPRINTF(buffer, bufferSize, "%llu", static_cast<unsigned long long>(v));
 }
 
-bool XMLUtil::ToInt(const char* str, int* value)
+// Reads the decimal number at the start of str, after white space and an optional '+'.
+// Returns the end of the number, or null if there is none or it doesn't fit in T; value
+// is only set on success.
+template< typename T >
+static const char* ReadNumber( const char* str, T* value )
 {
-    if (IsPrefixHex(str)) {
-        unsigned v;
-        if (TIXML_SSCANF(str, "%x", &v) == 1) {
-            *value = static_cast<int>(v);
-            return true;
+    TIXMLASSERT( str );
+    TIXMLASSERT( value );
+    const char* p = XMLUtil::SkipWhiteSpace( str, 0 );
+    if ( *p == '+' && *(p+1) != '-' ) {
+        ++p;
+    }
+    T v = 0;
+#ifdef TIXML_FROM_CHARS
+    // from_chars wants the end of the input. Stop at the first character no number can hold,
+    // so that a long list of numbers isn't scanned to its end for every value.
+    const char* end = p;
+    while ( isalnum( static_cast<unsigned char>(*end) ) || *end == '.' || *end == '-' || *end == '+' ) {
+        ++end;
+    }
+    const std::from_chars_result result = std::from_chars( p, end, v );
+    if ( result.ec != std::errc() ) {
+        return 0;
+    }
+    end = result.ptr;
+#else
+    // Same forms through strtod and strtoll, but the decimal point follows the C locale.
+    char* end = 0;
+    errno = 0;
+    if ( static_cast<T>( 0.5 ) != 0 ) {
+        const double d = strtod( p, &end );
+        v = static_cast<T>( d );
+    }
+    else if ( static_cast<T>( -1 ) < 0 ) {
+        const long long ll = strtoll( p, &end, 10 );
+        v = static_cast<T>( ll );
+        if ( errno == ERANGE || static_cast<long long>( v ) != ll ) {
+            return 0;
         }
     }
     else {
-        if (TIXML_SSCANF(str, "%d", value) == 1) {
-            return true;
+        const unsigned long long ull = strtoull( p, &end, 10 );
+        v = static_cast<T>( ull );
+        if ( *p == '-' || errno == ERANGE || static_cast<unsigned long long>( v ) != ull ) {
+            return 0;
         }
     }
-    return false;
+    if ( end == p ) {
+        return 0;
+    }
+#endif
+    // The 0 of a hex number isn't a decimal number of its own.
+    if ( *end == 'x' || *end == 'X' ) {
+        return 0;
+    }
+    *value = v;
+    return end;
 }
 
-bool XMLUtil::ToUnsigned(const char* str, unsigned* value)
+
+const char* XMLUtil::ReadInt( const char* str, int* value )
 {
-    if (TIXML_SSCANF(str, IsPrefixHex(str) ? "%x" : "%u", value) == 1) {
-        return true;
-    }
-    return false;
+    return ReadNumber( str, value );
 }
 
-bool XMLUtil::ToBool( const char* str, bool* value )
+
+const char* XMLUtil::ReadUnsigned( const char* str, unsigned* value )
 {
-    int ival = 0;
-    if ( ToInt( str, &ival )) {
-        *value = (ival==0) ? false : true;
-        return true;
-    }
-    static const char* TRUE_VALS[] = { "true", "True", "TRUE", 0 };
-    static const char* FALSE_VALS[] = { "false", "False", "FALSE", 0 };
+    return ReadNumber( str, value );
+}
 
-    for (int i = 0; TRUE_VALS[i]; ++i) {
-        if (StringEqual(str, TRUE_VALS[i])) {
-            *value = true;
-            return true;
-        }
-    }
+
+const char* XMLUtil::ReadInt64( const char* str, int64_t* value )
+{
+    return ReadNumber( str, value );
+}
+
+
+const char* XMLUtil::ReadUnsigned64( const char* str, uint64_t* value )
+{
+    return ReadNumber( str, value );
+}
+
+
+const char* XMLUtil::ReadFloat( const char* str, float* value )
+{
+    return ReadNumber( str, value );
+}
+
+
+const char* XMLUtil::ReadDouble( const char* str, double* value )
+{
+    return ReadNumber( str, value );
+}
+
+
+// The To* converters take the fast path first. sscanf only sees hex, and whatever the
+// fast path rejects, so values out of range or in other forms convert as they always did.
+bool XMLUtil::ToInt(const char* str, int* value)
+{
+    if (IsPrefixHex(str)) {
+        unsigned v;
+        if (TIXML_SSCANF(str, "%x", &v) == 1) {
+            *value = static_cast<int>(v);
+            return true;
+        }
+    }
+    else {
+        if (ReadInt(str, value) || TIXML_SSCANF(str, "%d", value) == 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool XMLUtil::ToUnsigned(const char* str, unsigned* value)
+{
+    if (!IsPrefixHex(str) && ReadUnsigned(str, value)) {
+        return true;
+    }
+    if (TIXML_SSCANF(str, IsPrefixHex(str) ? "%x" : "%u", value) == 1) {
+        return true;
+    }
+    return false;
+}
+
+bool XMLUtil::ToBool( const char* str, bool* value )
+{
+    int ival = 0;
+    if ( ToInt( str, &ival )) {
+        *value = (ival==0) ? false : true;
+        return true;
+    }
+    static const char* TRUE_VALS[] = { "true", "True", "TRUE", 0 };
+    static const char* FALSE_VALS[] = { "false", "False", "FALSE", 0 };
+
+    for (int i = 0; TRUE_VALS[i]; ++i) {
+        if (StringEqual(str, TRUE_VALS[i])) {
+            *value = true;
+            return true;
+        }
+    }
     for (int i = 0; FALSE_VALS[i]; ++i) {
         if (StringEqual(str, FALSE_VALS[i])) {
             *value = false;
@@ -653,7 +1325,7 @@ bool XMLUtil::ToBool( const char* str, bool* value )
 
 bool XMLUtil::ToFloat( const char* str, float* value )
 {
-    if ( TIXML_SSCANF( str, "%f", value ) == 1 ) {
+    if ( ReadFloat( str, value ) || TIXML_SSCANF( str, "%f", value ) == 1 ) {
         return true;
     }
     return false;
@@ -662,7 +1334,7 @@ bool XMLUtil::ToFloat( const char* str, float* value )
 
 bool XMLUtil::ToDouble( const char* str, double* value )
 {
-    if ( TIXML_SSCANF( str, "%lf", value ) == 1 ) {
+    if ( ReadDouble( str, value ) || TIXML_SSCANF( str, "%lf", value ) == 1 ) {
         return true;
     }
     return false;
@@ -678,6 +1350,9 @@ bool XMLUtil::ToInt64(const char* str, int64_t* value)
             return true;
         }
     }
+    else if (ReadInt64(str, value)) {
+        return true;
+    }
     else {
         long long v = 0;	// horrible syntax trick to make the compiler happy about %lld
         if (TIXML_SSCANF(str, "%lld", &v) == 1) {
@@ -690,6 +1365,9 @@ bool XMLUtil::ToInt64(const char* str, int64_t* value)
 
 
 bool XMLUtil::ToUnsigned64(const char* str, uint64_t* value) {
+    if (!IsPrefixHex(str) && ReadUnsigned64(str, value)) {
+        return true;
+    }
     unsigned long long v = 0;	// horrible syntax trick to make the compiler happy about %llu
     if(TIXML_SSCANF(str, IsPrefixHex(str) ? "%llx" : "%llu", &v) == 1) {
         *value = static_cast<uint64_t>(v);
@@ -852,6 +1530,15 @@ const char* XMLNode::Value() const
     return _value.GetStr();
 }
 
+#ifdef TINYXML2_STRING_VIEW
+std::string_view XMLNode::ValueView() const
+{
+    if ( this->ToDocument() )
+        return std::string_view();
+    return _value.GetView();
+}
+#endif
+
 void XMLNode::SetValue( const char* str, bool staticMem )
 {
     if ( staticMem ) {
@@ -1127,7 +1814,8 @@ char* XMLNode::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr )
             // declarations have so far been added.
             bool wellLocated = false;
 
-            if (ToDocument()) {
+            // The parts of a parallel parse hold element content, see ParseParallel().
+            if (ToDocument() && _document->_parsingDepth == 1) {
                 if (FirstChild()) {
                     wellLocated =
                         FirstChild() &&
@@ -1148,6 +1836,10 @@ char* XMLNode::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr )
 
         XMLElement* ele = node->ToElement();
         if ( ele ) {
+            if ( ele->ClosingType() == XMLElement::SKIPPED ) {
+                _document->DeleteNode( node );
+                continue;
+            }
             // We read the end tag. Return it to the parent.
             if ( ele->ClosingType() == XMLElement::CLOSING ) {
                 if ( parentEndTag ) {
@@ -1170,7 +1862,8 @@ char* XMLNode::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr )
                 if ( ele->ClosingType() != XMLElement::OPEN ) {
                     mismatch = true;
                 }
-                else if ( !XMLUtil::StringEqual( endTag.GetStr(), ele->Name() ) ) {
+                else if ( _document->_internNames ? endTag.GetStr() != ele->Name() : !XMLUtil::StringEqual( endTag.GetStr(), ele->Name() ) ) {
+                    // interned names match exactly when they are the same pointer
                     mismatch = true;
                 }
             }
@@ -1439,10 +2132,22 @@ const char* XMLAttribute::Value() const
     return _value.GetStr();
 }
 
-char* XMLAttribute::ParseDeep( char* p, bool processEntities, int* curLineNumPtr )
+#ifdef TINYXML2_STRING_VIEW
+std::string_view XMLAttribute::NameView() const
+{
+    return _name.GetView();
+}
+
+std::string_view XMLAttribute::ValueView() const
+{
+    return _value.GetView();
+}
+#endif
+
+char* XMLAttribute::ParseDeep( char* p, bool processEntities, SymbolTable* symbols, int* curLineNumPtr )
 {
     // Parse using the name rules: bug fix, was using ParseText before
-    p = _name.ParseName( p );
+    p = _name.ParseName( p, symbols );
     if ( !p || !*p ) {
         return 0;
     }
@@ -1615,6 +2320,11 @@ XMLElement::~XMLElement()
 
 const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
 {
+    if ( _document->_internNames ) {
+        // A name the document never saw can't be on any element.
+        const char* symbol = _document->_symbols.Find( name );
+        return symbol ? FindInternedAttribute( symbol ) : 0;
+    }
     for( XMLAttribute* a = _rootAttribute; a; a = a->_next ) {
         if ( XMLUtil::StringEqual( a->Name(), name ) ) {
             return a;
@@ -1624,6 +2334,59 @@ const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
 }
 
 
+const XMLAttribute* XMLElement::FindInternedAttribute( const char* symbol ) const
+{
+    for( XMLAttribute* a = _rootAttribute; a; a = a->_next ) {
+        if ( a->_name.GetStr() == symbol ) {
+            return a;
+        }
+    }
+    return 0;
+}
+
+
+int XMLElement::FindAttributes( const char* const* names, const char** values, int count ) const
+{
+    TIXMLASSERT( count >= 0 );
+    TIXMLASSERT( !count || ( names && values ) );
+    for( int i = 0; i < count; ++i ) {
+        values[i] = 0;
+    }
+
+    if ( _document->_internNames ) {
+        DynArray<const char*, 8> symbols;
+        for( int i = 0; i < count; ++i ) {
+            symbols.Push( _document->_symbols.Find( names[i] ) );
+        }
+        int found = 0;
+        for( XMLAttribute* a = _rootAttribute; a && found < count; a = a->_next ) {
+            const char* name = a->_name.GetStr();
+            for( int i = 0; i < count; ++i ) {
+                if ( !values[i] && symbols[i] == name ) {
+                    values[i] = a->Value();
+                    ++found;
+                    break;
+                }
+            }
+        }
+        return found;
+    }
+
+    int found = 0;
+    for( XMLAttribute* a = _rootAttribute; a && found < count; a = a->_next ) {
+        const char* name = a->Name();
+        for( int i = 0; i < count; ++i ) {
+            if ( !values[i] && XMLUtil::StringEqual( name, names[i] ) ) {
+                values[i] = a->Value();
+                ++found;
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+
 const char* XMLElement::Attribute( const char* name, const char* value ) const
 {
     const XMLAttribute* a = FindAttribute( name );
@@ -1685,7 +2448,7 @@ float XMLElement::FloatAttribute(const char* name, float defaultValue) const
 	return f;
 }
 
-const char* XMLElement::GetText() const
+const XMLText* XMLElement::TextChild() const
 {
     /* skip comment node */
     const XMLNode* node = FirstChild();
@@ -1696,12 +2459,24 @@ const char* XMLElement::GetText() const
         }
         break;
     }
+    return node ? node->ToText() : 0;
+}
 
-    if ( node && node->ToText() ) {
-        return node->Value();
-    }
-    return 0;
+
+const char* XMLElement::GetText() const
+{
+    const XMLText* text = TextChild();
+    return text ? text->Value() : 0;
+}
+
+
+#ifdef TINYXML2_STRING_VIEW
+std::string_view XMLElement::GetTextView() const
+{
+    const XMLText* text = TextChild();
+    return text ? text->ValueView() : std::string_view();
 }
+#endif
 
 
 void	XMLElement::SetText( const char* inText )
@@ -1931,7 +2706,12 @@ XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
             TIXMLASSERT( _rootAttribute == 0 );
             _rootAttribute = attrib;
         }
-        attrib->SetName( name );
+        if ( _document->_internNames ) {
+            attrib->_name.SetInternedStr( _document->_symbols.Intern( name, strlen( name ) ) );
+        }
+        else {
+            attrib->SetName( name );
+        }
     }
     return attrib;
 }
@@ -1976,8 +2756,9 @@ char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
 
             const int attrLineNum = attrib->_parseLineNum;
 
-            p = attrib->ParseDeep( p, _document->ProcessEntities(), curLineNumPtr );
-            if ( !p || Attribute( attrib->Name() ) ) {
+            SymbolTable* symbols = _document->_internNames ? &_document->_symbols : 0;
+            p = attrib->ParseDeep( p, _document->ProcessEntities(), symbols, curLineNumPtr );
+            if ( !p || ( symbols ? FindInternedAttribute( attrib->Name() ) : FindAttribute( attrib->Name() ) ) ) {
                 DeleteAttribute( attrib );
                 _document->SetError( XML_ERROR_PARSING_ATTRIBUTE, attrLineNum, "XMLElement name=%s", Name() );
                 return 0;
@@ -2068,6 +2849,90 @@ XMLUnknown* XMLElement::InsertNewUnknown(const char* text)
 
 
 
+// Just past the first 'pattern' at or after p, or null.
+static char* FindEnd( char* p, const char* pattern )
+{
+    const size_t length = strlen( pattern );
+    for ( ;; ) {
+        p = const_cast<char*>( FindChar( p, *pattern, *pattern ) );
+        if ( !*p ) {
+            return 0;
+        }
+        if ( strncmp( p, pattern, length ) == 0 ) {
+            return p + length;
+        }
+        ++p;
+    }
+}
+
+static int CountLineFeedsIn( const char* p, const char* end )
+{
+    int count = 0;
+    while ( ( p = static_cast<const char*>( memchr( p, '\n', end - p ) ) ) != 0 ) {
+        ++count;
+        ++p;
+    }
+    return count;
+}
+
+
+// Skips the content of an element the way FindChunks() reads tags, counting lines.
+// Returns the name in the end tag that matches the start tag, or null.
+static char* SkipContent( char* p, int* curLineNumPtr )
+{
+    int depth = 1;
+    for ( ;; ) {
+        char* const tag = const_cast<char*>( FindChar( p, '<', '<' ) );
+        *curLineNumPtr += CountLineFeedsIn( p, tag );
+        if ( !*tag ) {
+            return 0;
+        }
+        if ( strncmp( tag, "<!--", 4 ) == 0 ) {
+            p = FindEnd( tag + 4, "-->" );
+        }
+        else if ( strncmp( tag, "<![CDATA[", 9 ) == 0 ) {
+            p = FindEnd( tag + 9, "]]>" );
+        }
+        else if ( tag[1] == '!' ) {
+            p = FindEnd( tag + 2, ">" );
+        }
+        else if ( tag[1] == '?' ) {
+            p = FindEnd( tag + 2, "?>" );
+        }
+        else {
+            char* const name = const_cast<char*>( XMLUtil::SkipWhiteSpace( tag + 1, 0 ) );
+            const bool closing = ( *name == '/' );
+            char* q = name;
+            while ( *q && *q != '>' ) {
+                if ( *q == '"' || *q == '\'' ) {
+                    q = const_cast<char*>( FindChar( q + 1, *q, *q ) );
+                    if ( !*q ) {
+                        return 0;
+                    }
+                }
+                ++q;
+            }
+            if ( !*q ) {
+                return 0;
+            }
+            const bool closed = ( q[-1] == '/' );
+            if ( closing && !closed && --depth == 0 ) {
+                *curLineNumPtr += CountLineFeedsIn( tag, name );
+                return name + 1;
+            }
+            if ( !closing && !closed ) {
+                ++depth;
+            }
+            p = q + 1;
+        }
+        if ( !p ) {
+            return 0;
+        }
+        *curLineNumPtr += CountLineFeedsIn( tag, p );
+    }
+}
+
+
 //
 //	<ele></ele>
 //	<ele>foo<b>bar</b></ele>
@@ -2085,13 +2950,39 @@ char* XMLElement::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr
         ++p;
     }
 
-    p = _value.ParseName( p );
+    p = _value.ParseName( p, _document->_internNames ? &_document->_symbols : 0 );
     if ( _value.Empty() ) {
         return 0;
     }
 
     p = ParseAttributes( p, curLineNumPtr );
-    if ( !p || !*p || _closingType != OPEN ) {
+    if ( !p ) {
+        return 0;
+    }
+    if ( _closingType != CLOSING && _document->_parsingDepth > 1 && _document->_elementFilter
+        && !_document->_elementFilter( *this, _document->_elementFilterContext ) ) {
+        // The parent drops the element; the content is only read for its end tag.
+        if ( _closingType == OPEN ) {
+            p = SkipContent( p, curLineNumPtr );
+            if ( !p ) {
+                return 0;
+            }
+            const size_t length = strlen( Name() );
+            if ( strncmp( p, Name(), length ) != 0 || XMLUtil::IsNameChar( static_cast<unsigned char>( p[length] ) ) ) {
+                _document->SetError( XML_ERROR_MISMATCHED_ELEMENT, _parseLineNum, "XMLElement name=%s", Name() );
+                return 0;
+            }
+            p = XMLUtil::SkipWhiteSpace( p + length, curLineNumPtr );
+            if ( *p != '>' ) {
+                _document->SetError( XML_ERROR_PARSING_ELEMENT, _parseLineNum, "XMLElement name=%s", Name() );
+                return 0;
+            }
+            ++p;
+        }
+        _closingType = SKIPPED;
+        return p;
+    }
+    if ( !*p || _closingType != OPEN ) {
         return p;
     }
 
@@ -2176,7 +3067,8 @@ const char* XMLDocument::_errorNames[XML_ERROR_COUNT] = {
     "XML_ERROR_PARSING",
     "XML_CAN_NOT_CONVERT_TEXT",
     "XML_NO_TEXT_NODE",
-	"XML_ELEMENT_DEPTH_EXCEEDED"
+	"XML_ELEMENT_DEPTH_EXCEEDED",
+	"XML_ERROR_INVALID_UTF8"
 };
 
 
@@ -2189,6 +3081,21 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
     _errorStr(),
     _errorLineNum( 0 ),
     _charBuffer( 0 ),
+    _charBufferCapacity( 0 ),
+    _inSituBuffer( 0 ),
+    _inSituSize( 0 ),
+    _inSituRelease( 0 ),
+    _inSituContext( 0 ),
+    _retainCapacity( false ),
+    _internNames( false ),
+    _internNamesOnClear( false ),
+    _validateUTF8( false ),
+    _symbols(),
+    _parseThreads( 0 ),
+    _parseChunkSize( 1024*1024 ),
+    _parts(),
+    _elementFilter( 0 ),
+    _elementFilterContext( 0 ),
     _parseCurLineNum( 0 ),
 	_parsingDepth(0),
     _unlinked(),
@@ -2204,6 +3111,7 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
 
 XMLDocument::~XMLDocument()
 {
+    _retainCapacity = false;
     Clear();
 }
 
@@ -2233,8 +3141,27 @@ void XMLDocument::Clear()
 #endif
     ClearError();
 
-    delete [] _charBuffer;
-    _charBuffer = 0;
+    if ( _inSituBuffer ) {
+        // The caller's buffer is never kept for reuse.
+        char* const buffer = _inSituBuffer;
+        _inSituBuffer = 0;
+        _inSituRelease( buffer, _inSituSize, _inSituContext );
+    }
+    // The parts of a parallel parse are empty by now; with retained capacity their pools serve the next parse.
+    for( size_t i = 0; i < _parts.Size(); ++i ) {
+        _parts[i]->Clear();
+        if ( !_retainCapacity ) {
+            delete _parts[i];
+        }
+    }
+    if ( !_retainCapacity ) {
+        _parts.Clear();
+        delete [] _charBuffer;
+        _charBuffer = 0;
+        _charBufferCapacity = 0;
+        _symbols.Clear();
+    }
+    _internNames = _internNamesOnClear;
 	_parsingDepth = 0;
 
 #if 0
@@ -2255,6 +3182,38 @@ void XMLDocument::Clear()
 }
 
 
+void XMLDocument::SetPoolBlockSize( size_t bytes )
+{
+    _elementPool.SetBlockSize( bytes );
+    _attributePool.SetBlockSize( bytes );
+    _textPool.SetBlockSize( bytes );
+    _commentPool.SetBlockSize( bytes );
+}
+
+
+void XMLDocument::SetInternNames( bool intern )
+{
+    // Names already in the document stay as they are, so an empty document switches at once
+    // and any other at the next Clear().
+    _internNamesOnClear = intern;
+    if ( NoChildren() && _unlinked.Empty() ) {
+        _internNames = intern;
+    }
+}
+
+
+void XMLDocument::ReserveCharBuffer( size_t size )
+{
+    // Room for size characters and the null terminator; a retained buffer is reused if it fits.
+    if ( _charBuffer && _charBufferCapacity > size ) {
+        return;
+    }
+    delete [] _charBuffer;
+    _charBuffer = new char[size+1];
+    _charBufferCapacity = size+1;
+}
+
+
 void XMLDocument::DeepCopy(XMLDocument* target) const
 {
 	TIXMLASSERT(target);
@@ -2399,8 +3358,7 @@ XMLError XMLDocument::LoadFile( FILE* fp )
     }
 
     const size_t size = static_cast<size_t>(filelength);
-    TIXMLASSERT( _charBuffer == 0 );
-    _charBuffer = new char[size+1];
+    ReserveCharBuffer( size );
     const size_t read = fread( _charBuffer, 1, size, fp );
     if ( read != size ) {
         SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
@@ -2409,7 +3367,7 @@ XMLError XMLDocument::LoadFile( FILE* fp )
 
     _charBuffer[size] = 0;
 
-    Parse();
+    ParseFrom( _charBuffer, size );
     return _errorID;
 }
 
@@ -2439,6 +3397,7 @@ XMLError XMLDocument::SaveFile( FILE* fp, bool compact )
     // for *this* call.
     ClearError();
     XMLPrinter stream( fp, compact );
+    stream.SetOutputBuffer( 0, 64*1024 );
     Print( &stream );
     return _errorID;
 }
@@ -2455,12 +3414,35 @@ XMLError XMLDocument::Parse( const char* xml, size_t nBytes )
     if ( nBytes == static_cast<size_t>(-1) ) {
         nBytes = strlen( xml );
     }
-    TIXMLASSERT( _charBuffer == 0 );
-    _charBuffer = new char[ nBytes+1 ];
+    ReserveCharBuffer( nBytes );
     memcpy( _charBuffer, xml, nBytes );
     _charBuffer[nBytes] = 0;
+    return ParseBuffer( _charBuffer, nBytes );
+}
+
+
+XMLError XMLDocument::ParseInSitu( char* xml, size_t nBytes, BufferRelease release, void* context )
+{
+    Clear();
+    if ( xml && release ) {
+        _inSituBuffer = xml;
+        _inSituSize = nBytes;
+        _inSituRelease = release;
+        _inSituContext = context;
+    }
+
+    if ( nBytes == 0 || !xml || !*xml ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+    xml[nBytes] = 0;
+    return ParseBuffer( xml, nBytes );
+}
 
-    Parse();
+
+XMLError XMLDocument::ParseBuffer( char* p, size_t size )
+{
+    ParseFrom( p, size );
     if ( Error() ) {
         // clean up now essentially dangling memory.
         // and the parse fail can put objects in the
@@ -2547,13 +3529,28 @@ const char* XMLDocument::ErrorName() const
     return ErrorIDToName(_errorID);
 }
 
-void XMLDocument::Parse()
+void XMLDocument::ParseFrom( char* p, size_t size )
 {
     TIXMLASSERT( NoChildren() ); // Clear() must have been called previously
-    TIXMLASSERT( _charBuffer );
+    TIXMLASSERT( p );
+#ifdef TIXML_THREADS
+    if ( _parseThreads > 1 && ParseParallel( p, size ) ) {
+        return;
+    }
+#endif
+    if ( _validateUTF8 ) {
+        const char* invalid = XMLUtil::FindInvalidUTF8( p, size );
+        if ( invalid ) {
+            int lineNum = 1;
+            for ( const char* q = p; q < invalid; ++q ) {
+                lineNum += ( *q == '\n' );
+            }
+            SetError( XML_ERROR_INVALID_UTF8, lineNum, "offset=%llu", static_cast<unsigned long long>( invalid - p ) );
+            return;
+        }
+    }
     _parseCurLineNum = 1;
     _parseLineNum = 1;
-    char* p = _charBuffer;
     p = XMLUtil::SkipWhiteSpace( p, &_parseCurLineNum );
     p = const_cast<char*>( XMLUtil::ReadBOM( p, &_writeBOM ) );
     if ( !*p ) {
@@ -2563,17 +3560,438 @@ void XMLDocument::Parse()
     ParseDeep(p, 0, &_parseCurLineNum );
 }
 
-void XMLDocument::PushDepth()
-{
-	_parsingDepth++;
-	if (_parsingDepth == TINYXML2_MAX_ELEMENT_DEPTH) {
-		SetError(XML_ELEMENT_DEPTH_EXCEEDED, _parseCurLineNum, "Element nesting is too deep." );
-	}
+#ifdef TIXML_THREADS
+
+/*
+	Finds where ParseParallel() may cut a document. publish( start ) gets the start of
+	the content of the root element, then children of the root at least 'chunkSize'
+	bytes apart with only white space between them and the markup before. True with
+	endTag set to the end tag of the root. False if the scan can't follow the document,
+	or if text runs up to the end tag, which has to stay with the text.
+*/
+template< class Publish >
+static bool FindChunks( char* p, size_t chunkSize, char** endTag, const Publish& publish )
+{
+    char* next = 0;
+    char* markupEnd = 0;
+    int depth = 0;
+    for ( ;; ) {
+        p = const_cast<char*>( FindChar( p, '<', '<' ) );
+        if ( !*p ) {
+            return false;
+        }
+        char* const tag = p;
+        if ( tag[1] == '!' ) {
+            if ( XMLUtil::StringEqual( tag, "<!--", 4 ) ) {
+                p = FindEnd( tag + 4, "-->" );
+            }
+            else if ( XMLUtil::StringEqual( tag, "<![CDATA[", 9 ) ) {
+                p = FindEnd( tag + 9, "]]>" );
+            }
+            else {
+                p = FindEnd( tag + 2, ">" );
+            }
+            if ( !p ) {
+                return false;
+            }
+        }
+        else if ( tag[1] == '?' ) {
+            p = FindEnd( tag + 2, "?>" );
+            if ( !p ) {
+                return false;
+            }
+        }
+        else {
+            // An element tag, read the way XMLElement::ParseDeep() does: white space may come
+            // before the '/' of an end tag, and attribute values may hold '>'.
+            const char* const name = XMLUtil::SkipWhiteSpace( tag + 1, 0 );
+            const bool closing = ( *name == '/' );
+            char* q = const_cast<char*>( name );
+            while ( *q && *q != '>' ) {
+                if ( *q == '"' || *q == '\'' ) {
+                    q = const_cast<char*>( FindChar( q + 1, *q, *q ) );
+                    if ( !*q ) {
+                        return false;
+                    }
+                }
+                ++q;
+            }
+            if ( !*q ) {
+                return false;
+            }
+            const bool closed = ( q[-1] == '/' );
+            p = q + 1;
+            if ( closing && !closed ) {
+                // The end tag that closes the root ends the scan.
+                if ( depth == 0 ) {
+                    return false;
+                }
+                if ( --depth == 0 ) {
+                    *endTag = tag;
+                    return SkipWhiteSpaceVector( markupEnd, 0 ) == tag;
+                }
+            }
+            else if ( depth == 0 ) {
+                if ( closed || !XMLUtil::IsNameStartChar( static_cast<unsigned char>( *name ) ) ) {
+                    return false;
+                }
+                depth = 1;
+                publish( p );
+                next = p + chunkSize;
+            }
+            else {
+                if ( depth == 1 && tag >= next && tag > markupEnd && SkipWhiteSpaceVector( markupEnd, 0 ) == tag ) {
+                    publish( tag );
+                    next = tag + chunkSize;
+                }
+                if ( !closed ) {
+                    ++depth;
+                }
+            }
+        }
+        if ( depth == 1 ) {
+            markupEnd = p;
+        }
+    }
 }
 
-void XMLDocument::PopDepth()
+
+// Runs job( i ) for every i < count on up to 'threads' threads, the calling one included.
+template< class Job >
+static void RunJobs( size_t count, int threads, const Job& job )
 {
-	TIXMLASSERT(_parsingDepth > 0);
+    std::atomic<size_t> next( 0 );
+    auto run = [&]() {
+        for( size_t i = next++; i < count; i = next++ ) {
+            job( i );
+        }
+    };
+    const size_t helpers = ( static_cast<size_t>( threads ) < count ? threads : count ) - 1;
+    std::thread* helper = new std::thread[helpers];
+    for( size_t i = 0; i < helpers; ++i ) {
+        helper[i] = std::thread( run );
+    }
+    run();
+    for( size_t i = 0; i < helpers; ++i ) {
+        helper[i].join();
+    }
+    delete [] helper;
+}
+
+
+static void DeleteHead( char* buffer, size_t, void* )
+{
+    delete [] buffer;
+}
+
+
+/*
+	The content of the root element is cut into chunks, which other threads parse into
+	documents of their own while the scan looks for the next cut; a chunk is parsed as if
+	it were the content of an element. The rest of the document, with the content replaced
+	by its line feeds, is parsed last. The nodes of the parts then move into this document.
+	False, with the buffer untouched, if the document can't be cut.
+*/
+bool XMLDocument::ParseParallel( char* p, size_t size )
+{
+    if ( _whitespaceMode == PEDANTIC_WHITESPACE ) {
+        return false;
+    }
+    // A few chunks per thread keep the threads busy while the scan looks for the last ones.
+    size_t chunkSize = size / ( 4 * static_cast<size_t>( _parseThreads ) );
+    if ( chunkSize < _parseChunkSize ) {
+        chunkSize = _parseChunkSize;
+    }
+    if ( size < 2 * chunkSize ) {
+        return false;
+    }
+
+    struct Chunk {
+        char*			start;
+        char*			end;
+        XMLDocument*	part;
+        int				firstLine;
+        int				lineFeeds;
+        const char*		invalid;
+    };
+    Chunk* const chunks = new Chunk[size / chunkSize + 2];
+    size_t count = 0;
+    size_t taken = 0;
+    bool scanned = false;
+    std::mutex mutex;
+    std::condition_variable published;
+
+    auto parseChunks = [&]() {
+        for ( ;; ) {
+            size_t i = 0;
+            {
+                std::unique_lock<std::mutex> lock( mutex );
+                published.wait( lock, [&]() { return taken < count || scanned; } );
+                if ( taken == count ) {
+                    return;
+                }
+                i = taken++;
+            }
+            Chunk& chunk = chunks[i];
+            XMLDocument* part = chunk.part;
+            chunk.lineFeeds += CountLineFeedsIn( chunk.start, chunk.end );
+            chunk.invalid = _validateUTF8 ? XMLUtil::FindInvalidUTF8( chunk.start, chunk.end - chunk.start ) : 0;
+            if ( !chunk.invalid ) {
+                // Lines count from the start of the chunk until Adopt().
+                part->_parseCurLineNum = 0;
+                part->_parsingDepth = 1;
+                part->ParseDeep( chunk.start, 0, &part->_parseCurLineNum );
+            }
+        }
+    };
+
+    // A part document configured like this one; the parts of an earlier parse are reused.
+    auto nextPart = [&]( size_t i ) {
+        if ( i == _parts.Size() ) {
+            _parts.Push( new XMLDocument( _processEntities, _whitespaceMode ) );
+        }
+        XMLDocument* part = _parts[i];
+        TIXMLASSERT( part->NoChildren() );
+        part->_processEntities = _processEntities;
+        part->_whitespaceMode = _whitespaceMode;
+        part->SetInternNames( _internNames );
+        part->SetPoolBlockSize( _elementPool.BlockSize() );
+        part->SetElementFilter( _elementFilter, _elementFilterContext );
+        return part;
+    };
+
+    std::thread* threads = 0;
+    char* contentStart = 0;
+    char* start = 0;
+    // The chunk from 'start' to 'end' goes to the threads. 'end' is the white space before
+    // the next chunk, or the end tag of the root, and becomes the terminator.
+    auto addChunk = [&]( char* end ) {
+        Chunk& chunk = chunks[count];
+        chunk.start = start;
+        chunk.end = end;
+        chunk.part = nextPart( count );
+        chunk.lineFeeds = ( *end == '\n' );
+        chunk.invalid = 0;
+        *end = 0;
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            ++count;
+        }
+        published.notify_one();
+        if ( !threads ) {
+            threads = new std::thread[_parseThreads - 1];
+            for( int i = 0; i < _parseThreads - 1; ++i ) {
+                threads[i] = std::thread( parseChunks );
+            }
+        }
+    };
+
+    char* endTag = 0;
+    const bool closed = FindChunks( p, chunkSize, &endTag, [&]( char* next ) {
+        if ( contentStart ) {
+            addChunk( next - 1 );
+        }
+        else {
+            contentStart = next;
+        }
+        start = next;
+    } );
+    if ( !count ) {
+        delete [] chunks;
+        return false;
+    }
+    // The head takes the rest of the document from the end tag of the root, or, if the scan
+    // failed, from the last cut, so that it finds the error as a parse on one thread would.
+    char* const rest = closed ? endTag : start;
+    const char restStart = *rest;
+    if ( closed ) {
+        addChunk( endTag );
+    }
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        scanned = true;
+    }
+    published.notify_all();
+    parseChunks();
+    for( int i = 0; i < _parseThreads - 1; ++i ) {
+        threads[i].join();
+    }
+    delete [] threads;
+
+    int line = 1 + CountLineFeedsIn( p, contentStart );
+    for( size_t i = 0; i < count; ++i ) {
+        chunks[i].firstLine = line;
+        line += chunks[i].lineFeeds;
+    }
+    const size_t lineFeeds = line - chunks[0].firstLine;
+    const size_t prologLength = contentStart - p;
+    const size_t epilogLength = ( p + size ) - rest;
+    const size_t headLength = prologLength + lineFeeds + epilogLength;
+    char* const head = new char[headLength + 1];
+    char* const epilog = head + prologLength + lineFeeds;
+    memcpy( head, p, prologLength );
+    memset( head + prologLength, '\n', lineFeeds );
+    memcpy( epilog, rest, epilogLength );
+    *epilog = restStart;
+
+    // Bad UTF-8 anywhere fails the parse before any other error.
+    if ( _validateUTF8 ) {
+        const char* invalid = XMLUtil::FindInvalidUTF8( head, prologLength );
+        int invalidLine = invalid ? 1 + CountLineFeedsIn( head, invalid ) : 0;
+        size_t offset = invalid ? invalid - head : 0;
+        for( size_t i = 0; i < count && !invalid; ++i ) {
+            invalid = chunks[i].invalid;
+            if ( invalid ) {
+                invalidLine = chunks[i].firstLine + CountLineFeedsIn( chunks[i].start, invalid );
+                offset = invalid - p;
+            }
+        }
+        if ( !invalid ) {
+            invalid = XMLUtil::FindInvalidUTF8( epilog, epilogLength );
+            if ( invalid ) {
+                invalidLine = 1 + CountLineFeedsIn( head, invalid );
+                offset = ( rest - p ) + ( invalid - epilog );
+            }
+        }
+        if ( invalid ) {
+            delete [] head;
+            for( size_t i = 0; i < count; ++i ) {
+                chunks[i].part->Clear();
+            }
+            delete [] chunks;
+            SetError( XML_ERROR_INVALID_UTF8, invalidLine, "offset=%llu", static_cast<unsigned long long>( offset ) );
+            return true;
+        }
+    }
+
+    XMLDocument* const headPart = nextPart( count );
+    headPart->ParseInSitu( head, headLength, DeleteHead );
+    _writeBOM = headPart->_writeBOM;
+
+    // The first error in the document wins. Errors of the head come from before the chunks,
+    // or after them: from the epilogue, from the tail of a failed scan, or from a root element
+    // that isn't closed properly, which is reported on the line of the root.
+    const XMLError headError = headPart->ErrorID();
+    const bool rootNotClosed = ( headError == XML_ERROR_MISMATCHED_ELEMENT || ( !closed && headError == XML_ERROR_PARSING ) );
+    XMLDocument* failed = 0;
+    int lineOffset = 0;
+    if ( headPart->Error() && headPart->ErrorLineNum() <= chunks[0].firstLine && !rootNotClosed ) {
+        failed = headPart;
+    }
+    for( size_t i = 0; i < count && !failed; ++i ) {
+        if ( chunks[i].part->Error() ) {
+            failed = chunks[i].part;
+            lineOffset = chunks[i].firstLine;
+        }
+    }
+    if ( !failed && headPart->Error() ) {
+        failed = headPart;
+    }
+    if ( failed ) {
+        const char* detail = strstr( failed->ErrorStr(), "Line number=" );
+        detail = detail ? strstr( detail, ": " ) : 0;
+        if ( detail ) {
+            SetError( failed->_errorID, failed->_errorLineNum + lineOffset, "%s", detail + 2 );
+        }
+        else {
+            SetError( failed->_errorID, failed->_errorLineNum + lineOffset, 0 );
+        }
+        for( size_t i = 0; i <= count; ++i ) {
+            _parts[i]->Clear();
+        }
+        delete [] chunks;
+        return true;
+    }
+
+    // The nodes move into this document, names interned by the parts are swapped for its own.
+    if ( _internNames ) {
+        for( size_t i = 0; i <= count; ++i ) {
+            _symbols.Merge( _parts[i]->_symbols );
+        }
+    }
+    XMLElement* const root = headPart->FirstChildElement();
+    TIXMLASSERT( root );
+    RunJobs( count + 1, _parseThreads, [&]( size_t i ) {
+        if ( i < count ) {
+            Adopt( chunks[i].part->_firstChild, root, chunks[i].firstLine );
+        }
+        else {
+            Adopt( headPart->_firstChild, this, 0 );
+        }
+    } );
+
+    _firstChild = headPart->_firstChild;
+    _lastChild = headPart->_lastChild;
+    headPart->_firstChild = headPart->_lastChild = 0;
+    // The chunks go before anything the head put into the root.
+    XMLNode* first = 0;
+    XMLNode* last = 0;
+    for( size_t i = 0; i < count; ++i ) {
+        XMLDocument* part = chunks[i].part;
+        if ( !part->_firstChild ) {
+            continue;
+        }
+        if ( last ) {
+            last->_next = part->_firstChild;
+            part->_firstChild->_prev = last;
+        }
+        else {
+            first = part->_firstChild;
+        }
+        last = part->_lastChild;
+        part->_firstChild = part->_lastChild = 0;
+    }
+    if ( first ) {
+        if ( root->_firstChild ) {
+            last->_next = root->_firstChild;
+            root->_firstChild->_prev = last;
+        }
+        else {
+            root->_lastChild = last;
+        }
+        root->_firstChild = first;
+    }
+    delete [] chunks;
+    return true;
+}
+
+
+void XMLDocument::Adopt( XMLNode* node, XMLNode* parent, int lineOffset )
+{
+    for( ; node; node = node->_next ) {
+        node->_document = this;
+        node->_parent = parent;
+        node->_parseLineNum += lineOffset;
+        XMLElement* element = node->ToElement();
+        if ( !element ) {
+            continue;
+        }
+        if ( _internNames ) {
+            element->_value.SetInternedStr( _symbols.Find( element->_value.GetStr() ) );
+        }
+        for( XMLAttribute* attribute = element->_rootAttribute; attribute; attribute = attribute->_next ) {
+            attribute->_parseLineNum += lineOffset;
+            if ( _internNames ) {
+                attribute->_name.SetInternedStr( _symbols.Find( attribute->_name.GetStr() ) );
+            }
+        }
+        Adopt( element->_firstChild, element, lineOffset );
+    }
+}
+
+#endif
+
+void XMLDocument::PushDepth()
+{
+	_parsingDepth++;
+	if (_parsingDepth == TINYXML2_MAX_ELEMENT_DEPTH) {
+		SetError(XML_ELEMENT_DEPTH_EXCEEDED, _parseCurLineNum, "Element nesting is too deep." );
+	}
+}
+
+void XMLDocument::PopDepth()
+{
+	TIXMLASSERT(_parsingDepth > 0);
 	--_parsingDepth;
 }
 
@@ -2586,7 +4004,11 @@ XMLPrinter::XMLPrinter( FILE* file, bool compact, int depth ) :
     _textDepth( -1 ),
     _processEntities( true ),
     _compactMode( compact ),
-    _buffer()
+    _buffer(),
+    _output( 0 ),
+    _outputSize( 0 ),
+    _outputLength( 0 ),
+    _ownsOutput( false )
 {
     for( int i=0; i<ENTITY_RANGE; ++i ) {
         _entityFlag[i] = false;
@@ -2605,12 +4027,40 @@ XMLPrinter::XMLPrinter( FILE* file, bool compact, int depth ) :
 }
 
 
+XMLPrinter::~XMLPrinter()
+{
+    SetOutputBuffer( 0, 0 );
+}
+
+
+void XMLPrinter::SetOutputBuffer( char* buffer, size_t size )
+{
+    Flush();
+    if ( _ownsOutput ) {
+        delete [] _output;
+    }
+    _ownsOutput = ( buffer == 0 && size > 0 );
+    _output = _ownsOutput ? new char[size] : buffer;
+    _outputSize = _output ? size : 0;
+}
+
+
+void XMLPrinter::Flush()
+{
+    if ( _fp && _outputLength ) {
+        fwrite( _output, sizeof(char), _outputLength, _fp );
+    }
+    _outputLength = 0;
+}
+
+
 void XMLPrinter::Print( const char* format, ... )
 {
     va_list     va;
     va_start( va, format );
 
     if ( _fp ) {
+        Flush();
         vfprintf( _fp, format, va );
     }
     else {
@@ -2630,7 +4080,18 @@ void XMLPrinter::Print( const char* format, ... )
 void XMLPrinter::Write( const char* data, size_t size )
 {
     if ( _fp ) {
-        fwrite ( data , sizeof(char), size, _fp);
+        if ( _outputSize - _outputLength < size ) {
+            Flush();
+            if ( _outputSize < size ) {
+                // Doesn't fit, or there is no output buffer.
+                fwrite ( data , sizeof(char), size, _fp);
+                return;
+            }
+        }
+        if ( _output ) {
+            memcpy( _output + _outputLength, data, size );
+            _outputLength += size;
+        }
     }
     else {
         char* p = _buffer.PushArr( static_cast<int>(size) ) - 1;   // back up over the null terminator.
@@ -2643,7 +4104,16 @@ void XMLPrinter::Write( const char* data, size_t size )
 void XMLPrinter::Putc( char ch )
 {
     if ( _fp ) {
-        fputc ( ch, _fp);
+        if ( _outputLength < _outputSize ) {
+            _output[_outputLength++] = ch;
+        }
+        else if ( _outputSize ) {
+            Flush();
+            _output[_outputLength++] = ch;
+        }
+        else {
+            fputc ( ch, _fp);
+        }
     }
     else {
         char* p = _buffer.PushArr( sizeof(char) ) - 1;   // back up over the null terminator.
@@ -3016,4 +4486,535 @@ bool XMLPrinter::Visit( const XMLUnknown& unknown )
     return true;
 }
 
+// --------- XMLReader ----------- //
+
+XMLReader::XMLReader( bool processEntities, Whitespace whitespaceMode ) :
+    _processEntities( processEntities ),
+    _whitespaceMode( whitespaceMode ),
+    _fp( 0 ),
+    _ownsFile( false ),
+    _mem( 0 ),
+    _memSize( 0 ),
+    _buffer( 0 ),
+    _capacity( 0 ),
+    _chunkSize( 64 * 1024 ),
+    _pos( 0 ),
+    _end( 0 ),
+    _eof( false ),
+    _restore( 0 ),
+    _started( false ),
+    _first( true ),
+    _closeEmpty( false ),
+    _finished( false ),
+    _event( END_OF_DOCUMENT ),
+    _name(),
+    _text(),
+    _cdata( false ),
+    _rootAttribute( 0 ),
+    _attributePool(),
+    _openNames(),
+    _openStarts(),
+    _lineNum( 1 ),
+    _eventLineNum( 0 ),
+    _errorID( XML_SUCCESS ),
+    _errorLineNum( 0 )
+{
+}
+
+
+XMLReader::~XMLReader()
+{
+    Reset();
+    delete [] _buffer;
+}
+
+
+XMLError XMLReader::Open( const char* filename )
+{
+    Reset();
+    FILE* fp = callfopen( filename, "rb" );
+    if ( !fp ) {
+        SetError( XML_ERROR_FILE_NOT_FOUND, 0 );
+        return _errorID;
+    }
+    _fp = fp;
+    _ownsFile = true;
+    return XML_SUCCESS;
+}
+
+
+void XMLReader::SetInput( FILE* fp )
+{
+    Reset();
+    _fp = fp;
+}
+
+
+void XMLReader::SetInput( const char* xml, size_t nBytes )
+{
+    Reset();
+    if ( nBytes == static_cast<size_t>(-1) ) {
+        nBytes = xml ? strlen( xml ) : 0;
+    }
+    _mem = xml;
+    _memSize = xml ? nBytes : 0;
+}
+
+
+void XMLReader::SetChunkSize( size_t bytes )
+{
+    _chunkSize = bytes > 16 ? bytes : 16;
+}
+
+
+void XMLReader::Reset()
+{
+    ReleaseEvent();
+    _name.Reset();
+    if ( _ownsFile && _fp ) {
+        fclose( _fp );
+    }
+    _fp = 0;
+    _ownsFile = false;
+    _mem = 0;
+    _memSize = 0;
+    _pos = 0;
+    _end = 0;
+    _eof = false;
+    _started = false;
+    _first = true;
+    _closeEmpty = false;
+    _finished = false;
+    _event = END_OF_DOCUMENT;
+    _openNames.Clear();
+    _openStarts.Clear();
+    _lineNum = 1;
+    _eventLineNum = 0;
+    _errorID = XML_SUCCESS;
+    _errorLineNum = 0;
+}
+
+
+void XMLReader::ReleaseEvent()
+{
+    if ( _restore ) {
+        _buffer[_restore] = '<';
+        _restore = 0;
+    }
+    while ( _rootAttribute ) {
+        XMLAttribute* next = _rootAttribute->_next;
+        _rootAttribute->~XMLAttribute();
+        _attributePool.Free( _rootAttribute );
+        _rootAttribute = next;
+    }
+    _text.Reset();
+    _cdata = false;
+}
+
+
+bool XMLReader::Fill()
+{
+    if ( _eof || ( !_fp && !_mem ) ) {
+        return false;
+    }
+    // Keep only what wasn't read yet, at the front.
+    if ( _pos > 0 ) {
+        memmove( _buffer, _buffer + _pos, _end - _pos );
+        _end -= _pos;
+        _pos = 0;
+    }
+    // Grow when a token fills most of the buffer, so reads stay large.
+    if ( _capacity - _end < _chunkSize / 2 ) {
+        const size_t capacity = _end + _chunkSize > 2 * _capacity ? _end + _chunkSize : 2 * _capacity;
+        char* buffer = new char[capacity+1];
+        if ( _buffer ) {
+            memcpy( buffer, _buffer, _end );
+            delete [] _buffer;
+        }
+        _buffer = buffer;
+        _capacity = capacity;
+    }
+
+    const size_t space = _capacity - _end;
+    size_t read = 0;
+    if ( _fp ) {
+        read = fread( _buffer + _end, 1, space, _fp );
+        if ( read < space ) {
+            _eof = true;
+            if ( ferror( _fp ) ) {
+                SetError( XML_ERROR_FILE_READ_ERROR, _lineNum );
+            }
+        }
+    }
+    else {
+        read = _memSize < space ? _memSize : space;
+        memcpy( _buffer + _end, _mem, read );
+        _mem += read;
+        _memSize -= read;
+        _eof = _memSize == 0;
+    }
+    // The DOM stops at a null character as well.
+    const void* nul = memchr( _buffer + _end, 0, read );
+    if ( nul ) {
+        read = static_cast<size_t>( static_cast<const char*>( nul ) - ( _buffer + _end ) );
+        _eof = true;
+    }
+    _end += read;
+    _buffer[_end] = 0;
+    return read > 0;
+}
+
+
+bool XMLReader::Buffered( size_t n )
+{
+    while ( _end - _pos < n ) {
+        if ( !Fill() ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+size_t XMLReader::SkipWhiteSpace( size_t from )
+{
+    // Offset from _pos of the first character after the white space at from.
+    for (;;) {
+        if ( _pos + from < _end ) {
+            const char* p = XMLUtil::SkipWhiteSpace( _buffer + _pos + from, &_lineNum );
+            from = static_cast<size_t>( p - ( _buffer + _pos ) );
+            if ( *p ) {
+                return from;
+            }
+        }
+        if ( !Fill() ) {
+            return from;
+        }
+    }
+}
+
+
+size_t XMLReader::Find( size_t from, const char* terminator )
+{
+    // Offset from _pos of the terminator, reading on until it is buffered; 0 if the input ends first.
+    const size_t length = strlen( terminator );
+    for (;;) {
+        if ( _pos + from < _end ) {
+            const char* p = FindChar( _buffer + _pos + from, *terminator, *terminator );
+            from = static_cast<size_t>( p - ( _buffer + _pos ) );
+            if ( *p && _end - _pos - from >= length ) {
+                if ( strncmp( p, terminator, length ) == 0 ) {
+                    return from;
+                }
+                ++from;
+                continue;
+            }
+        }
+        if ( !Fill() ) {
+            return 0;
+        }
+    }
+}
+
+
+size_t XMLReader::FindTagEnd( size_t from )
+{
+    // Offset from _pos of the '>' closing the tag at _pos, past quoted attribute values; 0 if the input ends first.
+    char quote = 0;
+    for (;;) {
+        for( ; _pos + from < _end; ++from ) {
+            const char c = _buffer[_pos + from];
+            if ( quote ) {
+                if ( c == quote ) {
+                    quote = 0;
+                }
+            }
+            else if ( c == '>' ) {
+                return from;
+            }
+            else if ( c == '\"' || c == '\'' ) {
+                quote = c;
+            }
+        }
+        if ( !Fill() ) {
+            return 0;
+        }
+    }
+}
+
+
+XMLReader::Event XMLReader::Next()
+{
+    if ( Error() ) {
+        return READ_ERROR;
+    }
+    if ( _finished ) {
+        return END_OF_DOCUMENT;
+    }
+    ReleaseEvent();
+    if ( _closeEmpty ) {
+        // <a/> has no content, its end follows right away.
+        _closeEmpty = false;
+        _event = END_ELEMENT;
+        return _event;
+    }
+    _name.Reset();
+
+    if ( !_started ) {
+        // As XMLDocument::Parse(): white space and a BOM before the document are dropped.
+        _started = true;
+        const size_t ws = SkipWhiteSpace( 0 );
+        _pos += ws;
+        bool bom = false;
+        if ( Buffered( 3 ) ) {
+            _pos = static_cast<size_t>( XMLUtil::ReadBOM( _buffer + _pos, &bom ) - _buffer );
+        }
+        if ( !Buffered( 1 ) ) {
+            return SetError( Error() ? _errorID : XML_ERROR_EMPTY_DOCUMENT, 0 );
+        }
+    }
+
+    // As XMLDocument::Identify(): markup after white space, or text with the white space.
+    for (;;) {
+        const int startLine = _lineNum;
+        const size_t ws = SkipWhiteSpace( 0 );
+        if ( Error() ) {
+            return READ_ERROR;
+        }
+        if ( _pos + ws == _end ) {
+            _pos = _end;
+            if ( !_openStarts.Empty() ) {
+                return SetError( XML_ERROR_PARSING, _lineNum );
+            }
+            _finished = true;
+            _eventLineNum = _lineNum;
+            _event = END_OF_DOCUMENT;
+            return _event;
+        }
+        Buffered( ws + 9 );     // long enough for any header, or the input ends
+        const char* p = _buffer + _pos + ws;
+        _eventLineNum = _lineNum;
+
+        if ( *p != '<' ) {
+            return ReadText( ws, startLine );
+        }
+        if ( *(p+1) == '/' && _first && ws > 0 && _whitespaceMode == PEDANTIC_WHITESPACE ) {
+            // Preserve whitespace pedantically before closing tag, when it's immediately after opening tag
+            _eventLineNum = startLine;
+            return ReadText( ws, startLine );
+        }
+
+        _pos += ws;
+        bool skipped = true;
+        if ( XMLUtil::StringEqual( p, "<?", 2 ) ) {
+            skipped = Skip( 2, "?>", StrPair::NEEDS_NEWLINE_NORMALIZATION, XML_ERROR_PARSING_DECLARATION );
+        }
+        else if ( XMLUtil::StringEqual( p, "<!--", 4 ) ) {
+            skipped = Skip( 4, "-->", StrPair::COMMENT, XML_ERROR_PARSING_COMMENT );
+        }
+        else if ( XMLUtil::StringEqual( p, "<![CDATA[", 9 ) ) {
+            const size_t end = Find( 9, "]]>" );
+            if ( !end ) {
+                return SetError( Error() ? _errorID : XML_ERROR_PARSING_CDATA, _eventLineNum );
+            }
+            char* q = _text.ParseText( _buffer + _pos + 9, "]]>", StrPair::NEEDS_NEWLINE_NORMALIZATION, &_lineNum );
+            TIXMLASSERT( q );
+            _pos = static_cast<size_t>( q - _buffer );
+            _cdata = true;
+            _first = false;
+            _event = TEXT;
+            return _event;
+        }
+        else if ( XMLUtil::StringEqual( p, "<!", 2 ) ) {
+            skipped = Skip( 2, ">", StrPair::NEEDS_NEWLINE_NORMALIZATION, XML_ERROR_PARSING_UNKNOWN );
+        }
+        else if ( *(p+1) == '/' ) {
+            return ReadEndElement();
+        }
+        else {
+            return ReadElement();
+        }
+        if ( !skipped ) {
+            return READ_ERROR;
+        }
+    }
+}
+
+
+bool XMLReader::Skip( size_t headerLength, const char* terminator, int flags, XMLError error )
+{
+    // Comments, declarations and DTDs only move the reader on.
+    if ( !Find( headerLength, terminator ) ) {
+        SetError( Error() ? _errorID : error, _eventLineNum );
+        return false;
+    }
+    StrPair skipped;
+    char* q = skipped.ParseText( _buffer + _pos + headerLength, terminator, flags, &_lineNum );
+    TIXMLASSERT( q );
+    _pos = static_cast<size_t>( q - _buffer );
+    _first = false;
+    return true;
+}
+
+
+XMLReader::Event XMLReader::ReadText( size_t from, int startLine )
+{
+    // As XMLText::ParseDeep(): all the text counts, white space before it included.
+    if ( !Find( from, "<" ) ) {
+        return SetError( Error() ? _errorID : XML_ERROR_PARSING_TEXT, _eventLineNum );
+    }
+    int flags = _processEntities ? StrPair::TEXT_ELEMENT : StrPair::TEXT_ELEMENT_LEAVE_ENTITIES;
+    if ( _whitespaceMode == COLLAPSE_WHITESPACE ) {
+        flags |= StrPair::NEEDS_WHITESPACE_COLLAPSING;
+    }
+    _lineNum = startLine;
+    char* q = _text.ParseText( _buffer + _pos, "<", flags, &_lineNum );
+    TIXMLASSERT( q );
+    // Text() ends the string on the '<' of the next tag, put back by ReleaseEvent().
+    _pos = static_cast<size_t>( q - 1 - _buffer );
+    _restore = _pos;
+    _first = false;
+    _event = TEXT;
+    return _event;
+}
+
+
+XMLReader::Event XMLReader::ReadElement()
+{
+    const int lineNum = _lineNum;
+    if ( !FindTagEnd( 1 ) ) {
+        return SetError( Error() ? _errorID : XML_ERROR_PARSING_ELEMENT, lineNum );
+    }
+    char* p = _name.ParseName( _buffer + _pos + 1 );
+    if ( !p ) {
+        return SetError( XML_ERROR_PARSING_ELEMENT, lineNum );
+    }
+
+    // The attribute loop of XMLElement::ParseAttributes(); the whole tag is buffered.
+    XMLAttribute* prevAttribute = 0;
+    bool open = false;
+    for (;;) {
+        p = XMLUtil::SkipWhiteSpace( p, &_lineNum );
+        if ( XMLUtil::IsNameStartChar( static_cast<unsigned char>(*p) ) ) {
+            XMLAttribute* attrib = new ( _attributePool.Alloc() ) XMLAttribute();
+            attrib->_memPool = &_attributePool;
+            attrib->_parseLineNum = _lineNum;
+            p = attrib->ParseDeep( p, _processEntities, 0, &_lineNum );
+            if ( !p || FindAttribute( attrib->Name() ) ) {
+                const int attrLineNum = attrib->_parseLineNum;
+                attrib->~XMLAttribute();
+                _attributePool.Free( attrib );
+                return SetError( XML_ERROR_PARSING_ATTRIBUTE, attrLineNum );
+            }
+            if ( prevAttribute ) {
+                prevAttribute->_next = attrib;
+            }
+            else {
+                _rootAttribute = attrib;
+            }
+            prevAttribute = attrib;
+        }
+        else if ( *p == '>' ) {
+            ++p;
+            open = true;
+            break;
+        }
+        else if ( *p == '/' && *(p+1) == '>' ) {
+            p += 2;
+            break;
+        }
+        else {
+            return SetError( XML_ERROR_PARSING_ELEMENT, lineNum );
+        }
+    }
+    _pos = static_cast<size_t>( p - _buffer );
+
+    if ( open ) {
+        // Same limit as XMLDocument, which counts itself as a level.
+        if ( _openStarts.Size() + 2 >= static_cast<size_t>( TINYXML2_MAX_ELEMENT_DEPTH ) ) {
+            return SetError( XML_ELEMENT_DEPTH_EXCEEDED, lineNum );
+        }
+        const char* name = _name.GetStr();
+        const size_t length = strlen( name ) + 1;
+        _openStarts.Push( _openNames.Size() );
+        memcpy( _openNames.PushArr( length ), name, length );
+    }
+    _closeEmpty = !open;
+    _first = open;
+    _event = START_ELEMENT;
+    return _event;
+}
+
+
+XMLReader::Event XMLReader::ReadEndElement()
+{
+    const int lineNum = _lineNum;
+    if ( !FindTagEnd( 2 ) ) {
+        return SetError( Error() ? _errorID : XML_ERROR_PARSING_ELEMENT, lineNum );
+    }
+    char* p = _name.ParseName( _buffer + _pos + 2 );
+    if ( !p ) {
+        return SetError( XML_ERROR_PARSING_ELEMENT, lineNum );
+    }
+    p = XMLUtil::SkipWhiteSpace( p, &_lineNum );
+    if ( *p != '>' ) {
+        return SetError( XML_ERROR_PARSING_ELEMENT, lineNum );
+    }
+    _pos = static_cast<size_t>( p + 1 - _buffer );
+
+    if ( _openStarts.Empty() || !XMLUtil::StringEqual( _name.GetStr(), &_openNames[_openStarts.PeekTop()] ) ) {
+        return SetError( XML_ERROR_MISMATCHED_ELEMENT, lineNum );
+    }
+    _openNames.PopArr( _openNames.Size() - _openStarts.Pop() );
+    _first = false;
+    _event = END_ELEMENT;
+    return _event;
+}
+
+
+XMLReader::Event XMLReader::SetError( XMLError error, int lineNum )
+{
+    _errorID = error;
+    _errorLineNum = lineNum;
+    _event = READ_ERROR;
+    return _event;
+}
+
+
+const char* XMLReader::Name() const
+{
+    if ( _event != START_ELEMENT && _event != END_ELEMENT ) {
+        return 0;
+    }
+    return _name.GetStr();
+}
+
+
+const char* XMLReader::Text() const
+{
+    if ( _event != TEXT ) {
+        return 0;
+    }
+    return _text.GetStr();
+}
+
+
+const XMLAttribute* XMLReader::FindAttribute( const char* name ) const
+{
+    for( const XMLAttribute* a = _rootAttribute; a; a = a->_next ) {
+        if ( XMLUtil::StringEqual( a->Name(), name ) ) {
+            return a;
+        }
+    }
+    return 0;
+}
+
+
+const char* XMLReader::Attribute( const char* name ) const
+{
+    const XMLAttribute* a = FindAttribute( name );
+    return a ? a->Value() : 0;
+}
+
+
 }   // namespace tinyxml2
@@ -42,6 +42,12 @@ distribution.
 #endif
 #include <stdint.h>
 
+// The string_view accessors (ValueView() and friends) need C++17.
+#if __cplusplus >= 201703L || ( defined(_MSVC_LANG) && _MSVC_LANG >= 201703L )
+#   include <string_view>
+#   define TINYXML2_STRING_VIEW
+#endif
+
 /*
 	gcc:
         g++ -Wall -DTINYXML2_DEBUG tinyxml2.cpp xmltest.cpp -o gccxmltest.exe
@@ -121,6 +127,7 @@ class XMLText;
 class XMLDeclaration;
 class XMLUnknown;
 class XMLPrinter;
+class SymbolTable;
 
 /*
 	A class that wraps strings. Normally stores the start and end
@@ -159,6 +166,9 @@ public:
     }
 
     const char* GetStr();
+#ifdef TINYXML2_STRING_VIEW
+    std::string_view GetView();
+#endif
 
     bool Empty() const {
         return _start == _end;
@@ -167,12 +177,13 @@ public:
     void SetInternedStr( const char* str ) {
         Reset();
         _start = const_cast<char*>(str);
+        _end = _start + strlen( str );
     }
 
     void SetStr( const char* str, int flags=0 );
 
     char* ParseText( char* in, const char* endTag, int strFlags, int* curLineNumPtr );
-    char* ParseName( char* in );
+    char* ParseName( char* in, SymbolTable* symbols=0 );
 
     void TransferTo( StrPair* other );
 	void Reset();
@@ -343,7 +354,7 @@ template< size_t ITEM_SIZE >
 class MemPoolT : public MemPool
 {
 public:
-    MemPoolT() : _blockPtrs(), _root(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)	{}
+    MemPoolT() : _blockPtrs(), _root(0), _itemsPerBlock(ITEMS_PER_BLOCK), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)	{}
     ~MemPoolT() {
         MemPoolT< ITEM_SIZE >::Clear();
     }
@@ -351,8 +362,8 @@ public:
     void Clear() {
         // Delete the blocks.
         while( !_blockPtrs.Empty()) {
-            Block* lastBlock = _blockPtrs.Pop();
-            delete lastBlock;
+            Item* lastBlock = _blockPtrs.Pop();
+            delete [] lastBlock;
         }
         _root = 0;
         _currentAllocs = 0;
@@ -368,17 +379,25 @@ public:
         return _currentAllocs;
     }
 
+    // Bytes allocated at once when the pool runs out of items. Applies to blocks allocated
+    // from now on; at least one item per block.
+    void SetBlockSize( size_t bytes ) {
+        _itemsPerBlock = bytes / ITEM_SIZE > 0 ? bytes / ITEM_SIZE : 1;
+    }
+    size_t BlockSize() const {
+        return _itemsPerBlock * ITEM_SIZE;
+    }
+
     virtual void* Alloc() override{
         if ( !_root ) {
             // Need a new block.
-            Block* block = new Block;
-            _blockPtrs.Push( block );
+            Item* blockItems = new Item[_itemsPerBlock];
+            _blockPtrs.Push( blockItems );
 
-            Item* blockItems = block->items;
-            for( size_t i = 0; i < ITEMS_PER_BLOCK - 1; ++i ) {
+            for( size_t i = 0; i < _itemsPerBlock - 1; ++i ) {
                 blockItems[i].next = &(blockItems[i + 1]);
             }
-            blockItems[ITEMS_PER_BLOCK - 1].next = 0;
+            blockItems[_itemsPerBlock - 1].next = 0;
             _root = blockItems;
         }
         Item* const result = _root;
@@ -429,6 +448,7 @@ public:
 	//		16k:	5200
 	//		32k:	4300
 	//		64k:	4000	21000
+    // Default items per block, see SetBlockSize().
     // Declared public because some compilers do not accept to use ITEMS_PER_BLOCK
     // in private part if ITEMS_PER_BLOCK is private
     enum { ITEMS_PER_BLOCK = (4 * 1024) / ITEM_SIZE };
@@ -441,11 +461,9 @@ private:
         Item*   next;
         char    itemData[static_cast<size_t>(ITEM_SIZE)];
     };
-    struct Block {
-        Item items[ITEMS_PER_BLOCK];
-    };
-    DynArray< Block*, 10 > _blockPtrs;
+    DynArray< Item*, 10 > _blockPtrs;
     Item* _root;
+    size_t _itemsPerBlock;
 
     size_t _currentAllocs;
     size_t _nAllocs;
@@ -454,6 +472,46 @@ private:
 };
 
 
+/*
+	Set of null terminated names, each distinct name stored once. Two
+	interned names are equal exactly when their pointers are. Open
+	addressing with linear probing; a document holds a few dozen names.
+*/
+class TINYXML2_LIB SymbolTable
+{
+public:
+    SymbolTable() : _symbols( 0 ), _hashes( 0 ), _capacity( 0 ), _size( 0 ) {}
+    ~SymbolTable() {
+        Clear();
+    }
+
+    // The stored copy of the name [str, str+len), added if not yet there.
+    const char* Intern( const char* str, size_t len );
+    // The stored copy of the name, or null if it was never interned.
+    const char* Find( const char* str ) const;
+    // Interns every name of the other table.
+    void Merge( const SymbolTable& other );
+    void Clear();
+
+    size_t Size() const {
+        return _size;
+    }
+
+private:
+    SymbolTable( const SymbolTable& ); // not supported
+    void operator=( const SymbolTable& ); // not supported
+
+    static unsigned Hash( const char* str, size_t len );
+    size_t Slot( const char* str, size_t len, unsigned hash ) const;
+    void Grow();
+
+    char**      _symbols;
+    unsigned*   _hashes;
+    size_t      _capacity;  // power of two, or 0
+    size_t      _size;
+};
+
+
 
 /**
 	Implements the interface to the "Visitor pattern" (see the Accept() method.)
@@ -536,6 +594,7 @@ enum XMLError {
     XML_CAN_NOT_CONVERT_TEXT,
     XML_NO_TEXT_NODE,
 	XML_ELEMENT_DEPTH_EXCEEDED,
+	XML_ERROR_INVALID_UTF8,
 
 	XML_ERROR_COUNT
 };
@@ -550,11 +609,9 @@ public:
     static const char* SkipWhiteSpace( const char* p, int* curLineNumPtr )	{
         TIXMLASSERT( p );
 
-        while( IsWhiteSpace(*p) ) {
-            if (curLineNumPtr && *p == '\n') {
-                ++(*curLineNumPtr);
-            }
-            ++p;
+        // Most runs are empty, longer ones are scanned a vector at a time.
+        if ( IsWhiteSpace(*p) ) {
+            p = SkipWhiteSpaceRun( p, curLineNumPtr );
         }
         TIXMLASSERT( p );
         return p;
@@ -563,6 +620,9 @@ public:
         return const_cast<char*>( SkipWhiteSpace( const_cast<const char*>(p), curLineNumPtr ) );
     }
 
+    // Skips whitespace starting at p, counting line feeds when curLineNumPtr is set.
+    static const char* SkipWhiteSpaceRun( const char* p, int* curLineNumPtr );
+
     // Anything in the high order range of UTF-8 is assumed to not be whitespace. This isn't
     // correct, but simple, and usually works.
     static bool IsWhiteSpace( char p )					{
@@ -611,6 +671,9 @@ public:
     // the UTF-8 value of the entity will be placed in value, and length filled in.
     static const char* GetCharacterRef( const char* p, char* value, int* length );
     static void ConvertUTF32ToUTF8( unsigned long input, char* output, int* length );
+    // The first byte of the first sequence in p[0, size) that isn't well formed UTF-8 (overlong
+    // forms, surrogates and code points past U+10FFFF included), or null if there is none.
+    static const char* FindInvalidUTF8( const char* p, size_t size );
 
     // converts primitive types to strings
     static void ToStr( int v, char* buffer, int bufferSize );
@@ -629,6 +692,16 @@ public:
     static bool ToDouble( const char* str, double* value );
 	static bool ToInt64(const char* str, int64_t* value);
     static bool ToUnsigned64(const char* str, uint64_t* value);
+
+    // Reads the decimal number at the start of str, skipping white space before it, and returns
+    // the end of the number; null if there is none. Independent of locale and doesn't need the
+    // number to be the whole string, so lists like "[1, 0.5]" can be read value by value.
+    static const char* ReadInt( const char* str, int* value );
+    static const char* ReadUnsigned( const char* str, unsigned* value );
+    static const char* ReadInt64( const char* str, int64_t* value );
+    static const char* ReadUnsigned64( const char* str, uint64_t* value );
+    static const char* ReadFloat( const char* str, float* value );
+    static const char* ReadDouble( const char* str, double* value );
 	// Changes what is serialized for a boolean value.
 	// Default to "true" and "false". Shouldn't be changed
 	// unless you have a special testing or compatibility need.
@@ -745,6 +818,14 @@ public:
     */
     const char* Value() const;
 
+#ifdef TINYXML2_STRING_VIEW
+    /** The Value() as a string_view; empty for the document. Parsed text without
+        entities or CR is viewed where it lies in the buffer, so it isn't normalized
+        and its null terminator isn't written.
+    */
+    std::string_view ValueView() const;
+#endif
+
     /** Set the Value of an XML node.
     	@sa Value()
     */
@@ -1142,6 +1223,8 @@ private:
 class TINYXML2_LIB XMLAttribute
 {
     friend class XMLElement;
+    friend class XMLReader;
+    friend class XMLDocument;
 public:
     /// The name of the attribute.
     const char* Name() const;
@@ -1149,6 +1232,13 @@ public:
     /// The value of the attribute.
     const char* Value() const;
 
+#ifdef TINYXML2_STRING_VIEW
+    /// The name of the attribute as a string_view.
+    std::string_view NameView() const;
+    /// The value of the attribute as a string_view. See XMLNode::ValueView().
+    std::string_view ValueView() const;
+#endif
+
     /// Gets the line number the attribute is in, if the document was parsed from a file.
     int GetLineNum() const { return _parseLineNum; }
 
@@ -1249,7 +1339,7 @@ private:
     void operator=( const XMLAttribute& );	// not supported
     void SetName( const char* name );
 
-    char* ParseDeep( char* p, bool processEntities, int* curLineNumPtr );
+    char* ParseDeep( char* p, bool processEntities, SymbolTable* symbols, int* curLineNumPtr );
 
     mutable StrPair _name;
     mutable StrPair _value;
@@ -1271,6 +1361,12 @@ public:
     const char* Name() const		{
         return Value();
     }
+#ifdef TINYXML2_STRING_VIEW
+    /// Get the name of an element as a string_view.
+    std::string_view NameView() const		{
+        return ValueView();
+    }
+#endif
     /// Set the name of the element.
     void SetName( const char* str, bool staticMem=false )	{
         SetValue( str, staticMem );
@@ -1519,6 +1615,20 @@ public:
     /// Query a specific attribute in the list.
     const XMLAttribute* FindAttribute( const char* name ) const;
 
+    /** Looks up several attributes in one walk over the attribute list,
+    	for elements whose attributes are read together:
+
+    	@verbatim
+    	static const char* const names[] = { "Name", "SID", "BlockType" };
+    	const char* values[3];
+    	ele->FindAttributes( names, values, 3 );
+    	@endverbatim
+
+    	values[i] is set to the value of the attribute names[i], or null
+    	if there is none. Returns the number of attributes found.
+    */
+    int FindAttributes( const char* const* names, const char** values, int count ) const;
+
     /** Convenience function for easy access to the text inside an element. Although easy
     	and concise, GetText() is limited compared to getting the XMLText child
     	and accessing it directly.
@@ -1549,6 +1659,11 @@ public:
     */
     const char* GetText() const;
 
+#ifdef TINYXML2_STRING_VIEW
+    /// GetText() as a string_view; empty where GetText() returns null. See XMLNode::ValueView().
+    std::string_view GetTextView() const;
+#endif
+
     /** Convenience function for easy access to the text inside an element. Although easy
     	and concise, SetText() is limited compared to creating an XMLText child
     	and mutating it directly.
@@ -1673,7 +1788,8 @@ public:
     enum ElementClosingType {
         OPEN,		// <foo>
         CLOSED,		// <foo/>
-        CLOSING		// </foo>
+        CLOSING,	// </foo>
+        SKIPPED		// <foo> rejected by the element filter, content and all
     };
     ElementClosingType ClosingType() const {
         return _closingType;
@@ -1691,6 +1807,8 @@ private:
     void operator=( const XMLElement& );	// not supported
 
     XMLAttribute* FindOrCreateAttribute( const char* name );
+    const XMLAttribute* FindInternedAttribute( const char* symbol ) const;
+    const XMLText* TextChild() const;
     char* ParseAttributes( char* p, int* curLineNumPtr );
     static void DeleteAttribute( XMLAttribute* attribute );
     XMLAttribute* CreateAttribute();
@@ -1752,6 +1870,31 @@ public:
     */
     XMLError Parse( const char* xml, size_t nBytes=static_cast<size_t>(-1) );
 
+    /// Frees a buffer handed to ParseInSitu(). 'context' is the one passed along with it.
+    typedef void (*BufferRelease)( char* buffer, size_t nBytes, void* context );
+
+    /**
+    	Parse 'nBytes' of XML in place, without copying them. The document
+    	keeps pointers into 'xml' and normalizes text in it when read, so the
+    	buffer must be writable, including 'xml[nBytes]' where the null
+    	terminator goes, and must live as long as the parsed nodes. An arena
+    	block will do, as will a private (copy on write) file mapping of a file
+    	that doesn't end exactly on a page boundary.
+
+    	If 'release' is given, the document owns the buffer and calls it with
+    	'context' on the next Clear(), Parse or load, or when destroyed,
+    	whether or not parsing succeeded. Otherwise the buffer stays the caller's.
+    	Returns XML_SUCCESS (0) on success, or an errorID.
+    	@verbatim
+    	void DeleteBuffer( char* buffer, size_t, void* ) { delete [] buffer; }
+
+    	char* xml = new char[size + 1];
+    	fread( xml, 1, size, fp );
+    	doc.ParseInSitu( xml, size, DeleteBuffer );
+    	@endverbatim
+    */
+    XMLError ParseInSitu( char* xml, size_t nBytes, BufferRelease release=0, void* context=0 );
+
     /**
     	Load an XML file from disk.
     	Returns XML_SUCCESS (0) on success, or
@@ -1908,6 +2051,96 @@ public:
     /// Clear the document, resetting it to the initial state.
     void Clear();
 
+    /**
+    	Sets how many bytes the node and attribute pools allocate at once.
+    	The default is 4k per pool. Large documents parse with fewer
+    	allocations using bigger blocks, e.g. 64k.
+    */
+    void SetPoolBlockSize( size_t bytes );
+
+    /**
+    	If set, Clear() (and so Parse() and LoadFile()) keeps the character
+    	buffer of the previous document for the next one. Node pools are
+    	always kept until the document is destroyed, so a document reused for
+    	many files then stops allocating once it has held the largest of them.
+    	The buffer is released by the destructor, or by Clear() after turning
+    	the mode off. Off by default.
+    */
+    void SetRetainCapacity( bool retain ) {
+        _retainCapacity = retain;
+    }
+    bool RetainCapacity() const {
+        return _retainCapacity;
+    }
+
+    /**
+    	If set, element and attribute names are interned: every distinct
+    	name is stored once per document, and attribute lookups and end tag
+    	checks compare pointers instead of strings. Pays off for documents
+    	whose elements carry many attributes. The names are kept along with
+    	the character buffer, see SetRetainCapacity(). A document that already
+    	holds nodes switches at the next Clear(), Parse() or LoadFile().
+    	Off by default.
+    */
+    void SetInternNames( bool intern );
+    bool InternNames() const {
+        return _internNames;
+    }
+
+    /**
+    	If set, Parse(), ParseInSitu() and LoadFile() check that the whole input
+    	is well formed UTF-8 before parsing it, and fail with XML_ERROR_INVALID_UTF8
+    	and the line of the first bad byte otherwise. Off by default.
+    */
+    void SetValidateUTF8( bool validate ) {
+        _validateUTF8 = validate;
+    }
+    bool ValidateUTF8() const {
+        return _validateUTF8;
+    }
+
+    /**
+    	Parses large documents on up to 'threads' threads, the calling one
+    	included. The content of the root element is cut between children
+    	into chunks of at least 'minChunkSize' bytes; other threads parse the
+    	chunks while the calling thread still looks for the next cut, and the
+    	nodes are joined under the root afterwards. The document, or the
+    	error of a broken one, is the same as from a parse on one thread.
+    	Documents smaller than two chunks and PEDANTIC_WHITESPACE parse on
+    	the calling thread, as does everything with 0 or 1 threads (the
+    	default) or in a build with TINYXML2_NO_THREADS.
+    */
+    void SetParseThreads( int threads, size_t minChunkSize = 1024*1024 ) {
+        _parseThreads = threads;
+        _parseChunkSize = minChunkSize ? minChunkSize : 1;
+    }
+    int ParseThreads() const {
+        return _parseThreads;
+    }
+
+    /// Decides whether a parsed element is kept. 'context' is the one passed to SetElementFilter().
+    typedef bool (*ElementFilter)( const XMLElement& element, void* context );
+
+    /**
+    	Sets a filter that sees every element below the document level once its
+    	attributes are read. An element it rejects is dropped from the document,
+    	and its content is skipped by matching tags without creating any nodes;
+    	the skipped content isn't checked beyond that. Line numbers of the rest
+    	of the document are unaffected. With SetParseThreads() the filter may be
+    	called from several threads at once. Null, the default, keeps everything.
+
+    	@code
+    	static bool NoComments( const XMLElement& element, void* ) {
+    		return !XMLUtil::StringEqual( element.Name(), "comments" );
+    	}
+    	doc.SetElementFilter( NoComments );
+    	@endcode
+    */
+    void SetElementFilter( ElementFilter filter, void* context=0 ) {
+        _elementFilter = filter;
+        _elementFilterContext = context;
+    }
+
 	/**
 		Copies this document to a target document.
 		The target will be completely cleared before the copy.
@@ -1941,6 +2174,23 @@ private:
     mutable StrPair	_errorStr;
     int             _errorLineNum;
     char*			_charBuffer;
+    size_t			_charBufferCapacity;
+    char*			_inSituBuffer;		// the caller's buffer of ParseInSitu(), if it is to be released
+    size_t			_inSituSize;
+    BufferRelease	_inSituRelease;
+    void*			_inSituContext;
+    bool			_retainCapacity;
+    bool			_internNames;
+    bool			_internNamesOnClear;
+    bool			_validateUTF8;
+    SymbolTable		_symbols;
+    int				_parseThreads;
+    size_t			_parseChunkSize;
+    // Documents of a parallel parse; they own the nodes and strings of the parts, so they live
+    // until the next Clear().
+    DynArray<XMLDocument*, 16> _parts;
+    ElementFilter	_elementFilter;
+    void*			_elementFilterContext;
     int				_parseCurLineNum;
 	int				_parsingDepth;
 	// Memory tracking does add some overhead.
@@ -1958,7 +2208,11 @@ private:
 
 	static const char* _errorNames[XML_ERROR_COUNT];
 
-    void Parse();
+    void ParseFrom( char* p, size_t size );
+    bool ParseParallel( char* p, size_t size );
+    void Adopt( XMLNode* node, XMLNode* parent, int lineOffset );
+    XMLError ParseBuffer( char* p, size_t size );
+    void ReserveCharBuffer( size_t size );
 
     void SetError( XMLError error, int lineNum, const char* format, ... );
 
@@ -2247,7 +2501,18 @@ public:
     	with only required whitespace and newlines.
     */
     XMLPrinter( FILE* file=0, bool compact = false, int depth = 0 );
-    virtual ~XMLPrinter()	{}
+    virtual ~XMLPrinter();
+
+    /**
+    	When printing to a FILE, collect the output in 'buffer' and fwrite() it
+    	when full, instead of handing every piece to the FILE. If 'buffer' is
+    	null the printer allocates 'size' bytes itself. The output reaches the
+    	FILE at Flush() and when the printer is destroyed; don't write to the
+    	FILE in between. Has no effect when printing to memory.
+    */
+    void SetOutputBuffer( char* buffer, size_t size );
+    /// Writes out what is collected in the output buffer. See SetOutputBuffer().
+    void Flush();
 
     /** If streaming, write the BOM and declaration. */
     void PushHeader( bool writeBOM, bool writeDeclaration );
@@ -2368,12 +2633,165 @@ private:
 
     DynArray< char, 20 > _buffer;
 
+    char* _output;			// the SetOutputBuffer() buffer, if any
+    size_t _outputSize;
+    size_t _outputLength;
+    bool _ownsOutput;
+
     // Prohibit cloning, intentionally not implemented
     XMLPrinter( const XMLPrinter& );
     XMLPrinter& operator=( const XMLPrinter& );
 };
 
 
+/**
+	Reads a document as a stream of events instead of building the DOM.
+	Input comes from a file or memory and is read a window at a time, so
+	memory use is bounded by the largest single tag or text, not by the
+	size of the document:
+
+	@verbatim
+	XMLReader reader;
+	reader.Open( "model.xml" );
+	for ( XMLReader::Event e = reader.Next(); e != XMLReader::END_OF_DOCUMENT; e = reader.Next() ) {
+		if ( e == XMLReader::READ_ERROR ) {
+			...
+		}
+		if ( e == XMLReader::START_ELEMENT && XMLUtil::StringEqual( reader.Name(), "Block" ) ) {
+			const char* sid = reader.Attribute( "SID" );
+			...
+		}
+	}
+	@endverbatim
+
+	Elements and text come out exactly as the DOM of the same document
+	would hold them, with the same entity and whitespace handling;
+	comments, declarations and DTDs are skipped. Strings and attributes of
+	an event are valid until the next call to Next().
+*/
+class TINYXML2_LIB XMLReader
+{
+public:
+    enum Event {
+        START_ELEMENT,      ///< Name() and the attributes of an element
+        END_ELEMENT,        ///< Name() of the element closed; also follows the START_ELEMENT of an empty element
+        TEXT,               ///< Text() of a text node or CDATA section
+        END_OF_DOCUMENT,
+        READ_ERROR          ///< see ErrorID(); the reader stops
+    };
+
+    XMLReader( bool processEntities = true, Whitespace whitespaceMode = PRESERVE_WHITESPACE );
+    ~XMLReader();
+
+    /// Reads the named file; the reader closes it.
+    XMLError Open( const char* filename );
+    /// Reads from a file opened in binary mode; the caller closes it.
+    void SetInput( FILE* fp );
+    /** Reads from memory, e.g. an mmap of the file. The data is read a
+    	window at a time and must stay valid until the end of the document.
+    	nBytes defaults to strlen( xml ).
+    */
+    void SetInput( const char* xml, size_t nBytes = static_cast<size_t>(-1) );
+
+    /** Bytes read from the input at once, 64k by default. The buffer grows
+    	past that only to hold a tag or text that doesn't fit.
+    */
+    void SetChunkSize( size_t bytes );
+    /// Current size of the buffer.
+    size_t BufferCapacity() const {
+        return _capacity;
+    }
+
+    /// Reads up to the next event.
+    Event Next();
+
+    /// Name of the element of a START_ELEMENT or END_ELEMENT.
+    const char* Name() const;
+    /// Text of a TEXT event.
+    const char* Text() const;
+    /// Whether the TEXT is a CDATA section.
+    bool CData() const {
+        return _cdata;
+    }
+    /// First attribute of the START_ELEMENT.
+    const XMLAttribute* FirstAttribute() const {
+        return _rootAttribute;
+    }
+    /// Attribute of the START_ELEMENT with the given name, or null.
+    const XMLAttribute* FindAttribute( const char* name ) const;
+    /// Value of the attribute of the START_ELEMENT with the given name, or null.
+    const char* Attribute( const char* name ) const;
+    /// Elements open after the event; 1 for the START_ELEMENT of the root.
+    int Depth() const {
+        return static_cast<int>( _openStarts.Size() );
+    }
+    /// Line of the event.
+    int LineNum() const {
+        return _eventLineNum;
+    }
+
+    bool Error() const {
+        return _errorID != XML_SUCCESS;
+    }
+    XMLError ErrorID() const {
+        return _errorID;
+    }
+    int ErrorLineNum() const {
+        return _errorLineNum;
+    }
+
+private:
+    XMLReader( const XMLReader& );	// not supported
+    void operator=( const XMLReader& );	// not supported
+
+    void Reset();
+    void ReleaseEvent();
+    bool Fill();
+    bool Buffered( size_t n );
+    size_t Find( size_t from, const char* terminator );
+    size_t SkipWhiteSpace( size_t from );
+    size_t FindTagEnd( size_t from );
+    Event ReadElement();
+    Event ReadEndElement();
+    Event ReadText( size_t from, int startLine );
+    bool Skip( size_t headerLength, const char* terminator, int flags, XMLError error );
+    Event SetError( XMLError error, int lineNum );
+
+    bool        _processEntities;
+    Whitespace  _whitespaceMode;
+    FILE*       _fp;
+    bool        _ownsFile;
+    const char* _mem;
+    size_t      _memSize;
+
+    char*       _buffer;        // window of the input, null terminated at _end
+    size_t      _capacity;
+    size_t      _chunkSize;
+    size_t      _pos;           // start of the next token
+    size_t      _end;
+    bool        _eof;
+    size_t      _restore;       // the '<' ending the text of the last event, overwritten by Text(); 0 if none
+
+    bool        _started;
+    bool        _first;         // next token comes first in its element, see PEDANTIC_WHITESPACE
+    bool        _closeEmpty;    // the last event opened <a/>, END_ELEMENT comes next
+    bool        _finished;
+    Event       _event;
+    mutable StrPair _name;
+    mutable StrPair _text;
+    bool        _cdata;
+    XMLAttribute* _rootAttribute;
+    MemPoolT< sizeof(XMLAttribute) > _attributePool;
+    DynArray< char, 256 > _openNames;     // names of open elements, null terminated one after the other
+    DynArray< size_t, 32 > _openStarts;   // where each of them starts in _openNames
+
+    int         _lineNum;
+    int         _eventLineNum;
+    XMLError    _errorID;
+    int         _errorLineNum;
+};
+
+
 } // namespace tinyxml2
 
 #if defined(_MSC_VER)
@@ -112,6 +112,121 @@ void NullLineEndings( char* p )
 }
 
 
+// Deletes a buffer handed to XMLDocument::ParseInSitu() and counts the calls in 'context'.
+void DeleteInSituBuffer( char* buffer, size_t, void* context )
+{
+	delete [] buffer;
+	++*static_cast<int*>( context );
+}
+
+
+// The node, or the first sibling after it, that is an element or text; XMLReader skips the others.
+static const XMLNode* ReaderNode( const XMLNode* node )
+{
+	while ( node && !node->ToElement() && !node->ToText() ) {
+		node = node->NextSibling();
+	}
+	return node;
+}
+
+
+// Walks the DOM along with the events of the reader. True if both hold the same elements,
+// attributes and text, on the same lines.
+bool ReaderMatchesDocument( XMLReader* reader, const XMLDocument& doc )
+{
+	const XMLNode* parent = &doc;
+	const XMLNode* node = ReaderNode( doc.FirstChild() );
+	for ( ;; ) {
+		switch ( reader->Next() ) {
+		case XMLReader::START_ELEMENT:
+		{
+			const XMLElement* element = node ? node->ToElement() : 0;
+			if ( !element || strcmp( element->Name(), reader->Name() ) || element->GetLineNum() != reader->LineNum() ) {
+				return false;
+			}
+			const XMLAttribute* a = element->FirstAttribute();
+			const XMLAttribute* b = reader->FirstAttribute();
+			for ( ; a && b; a = a->Next(), b = b->Next() ) {
+				if ( strcmp( a->Name(), b->Name() ) || strcmp( a->Value(), b->Value() ) ) {
+					return false;
+				}
+			}
+			if ( a || b ) {
+				return false;
+			}
+			parent = element;
+			node = ReaderNode( element->FirstChild() );
+			break;
+		}
+		case XMLReader::END_ELEMENT:
+			if ( node || !parent->ToElement() || strcmp( parent->Value(), reader->Name() ) ) {
+				return false;
+			}
+			node = ReaderNode( parent->NextSibling() );
+			parent = parent->Parent();
+			break;
+		case XMLReader::TEXT:
+		{
+			const XMLText* text = node ? node->ToText() : 0;
+			if ( !text || text->CData() != reader->CData() || strcmp( text->Value(), reader->Text() ) || text->GetLineNum() != reader->LineNum() ) {
+				return false;
+			}
+			node = ReaderNode( node->NextSibling() );
+			break;
+		}
+		case XMLReader::END_OF_DOCUMENT:
+			return !node && parent == &doc;
+		default:
+			return false;
+		}
+	}
+}
+
+
+// True if both runs of siblings hold the same nodes on the same lines, all the way down,
+// and the nodes of 'b' are linked to each other and to 'document'.
+bool SameNodes( const XMLNode* a, const XMLNode* b, const XMLDocument* document )
+{
+	for ( ; a && b; a = a->NextSibling(), b = b->NextSibling() ) {
+		if ( !a->ShallowEqual( b ) || a->GetLineNum() != b->GetLineNum() || b->GetDocument() != document ) {
+			return false;
+		}
+		if ( b->NextSibling() ? b->NextSibling()->PreviousSibling() != b : b->Parent()->LastChild() != b ) {
+			return false;
+		}
+		if ( a->ToElement() ) {
+			const XMLAttribute* x = a->ToElement()->FirstAttribute();
+			const XMLAttribute* y = b->ToElement()->FirstAttribute();
+			for ( ; x && y; x = x->Next(), y = y->Next() ) {
+				if ( x->GetLineNum() != y->GetLineNum() || b->ToElement()->FindAttribute( y->Name() ) != y ) {
+					return false;
+				}
+			}
+		}
+		if ( b->FirstChild() && b->FirstChild()->Parent() != b ) {
+			return false;
+		}
+		if ( !SameNodes( a->FirstChild(), b->FirstChild(), document ) ) {
+			return false;
+		}
+	}
+	return !a && !b;
+}
+
+
+// Element filter of the tests: rejects <drop> and the Position parameter, counting calls if asked.
+bool KeepElement( const XMLElement& element, void* context )
+{
+	if ( context ) {
+		++*static_cast<int*>( context );
+	}
+	if ( XMLUtil::StringEqual( element.Name(), "P" ) ) {
+		return !XMLUtil::StringEqual( element.Attribute( "Name" ), "Position" );
+	}
+	return !XMLUtil::StringEqual( element.Name(), "drop" );
+}
+
+
 int example_1()
 {
 	XMLDocument doc;
@@ -2695,6 +2810,637 @@ int main( int argc, const char ** argv )
 		XMLTest("Test attribute encode with a Hex value", value5, "!"); // hex value in unicode value
 	}
 
+	// ---------- Vector scanners -----------
+	{
+		// Whitespace, attribute values and text of every length around 16 and 32 bytes, so
+		// line feeds and terminators land at every offset within the scanned blocks.
+		bool linesMatch = true;
+		bool valuesMatch = true;
+		for ( int n = 0; n < 70; ++n ) {
+			char white[80];
+			char value[80];
+			char text[80];
+			int lineFeeds = 0;
+			for ( int i = 0; i < n; ++i ) {
+				white[i] = ( i % 5 == 2 ) ? '\n' : ( i % 3 == 0 ? '\t' : ' ' );
+				lineFeeds += white[i] == '\n';
+				value[i] = static_cast<char>( 'a' + i % 26 );
+				text[i] = ( i % 9 == 4 ) ? '\n' : static_cast<char>( 'A' + i % 26 );
+			}
+			white[n] = value[n] = text[n] = 0;
+
+			char xml[300];
+			snprintf( xml, sizeof( xml ), "<root>%s<child value='%s'>%s</child></root>", white, value, text );
+			XMLDocument doc;
+			doc.Parse( xml );
+			const XMLElement* child = doc.FirstChildElement( "root" ) ? doc.FirstChildElement( "root" )->FirstChildElement( "child" ) : 0;
+			if ( !child ) {
+				linesMatch = valuesMatch = false;
+				continue;
+			}
+			linesMatch = linesMatch && child->GetLineNum() == 1 + lineFeeds;
+			valuesMatch = valuesMatch && strcmp( child->Attribute( "value" ), value ) == 0 &&
+			              strcmp( child->GetText() ? child->GetText() : "", text ) == 0;
+		}
+		XMLTest( "Vector scanners: line numbers after whitespace runs", true, linesMatch );
+		XMLTest( "Vector scanners: attribute values and texts", true, valuesMatch );
+	}
+
+	// ---------- Reused document -----------
+	{
+		// One document parsing several inputs in turn, keeping its buffer and with large pool blocks.
+		static const char* large = "<root><a x='1'/><b>some longer text to grow the buffer</b><c/><d/><e/></root>";
+		static const char* small = "<r><a x='2'/></r>";
+		XMLDocument doc;
+		doc.SetPoolBlockSize( 64 * 1024 );
+		doc.SetRetainCapacity( true );
+		XMLTest( "Reused document: retain capacity", true, doc.RetainCapacity() );
+
+		doc.Parse( large );
+		XMLTest( "Reused document: parse large", false, doc.Error() );
+		doc.Parse( small );
+		XMLTest( "Reused document: parse small", false, doc.Error() );
+		XMLTest( "Reused document: small root", "r", doc.RootElement()->Name() );
+		XMLTest( "Reused document: small attribute", 2, doc.RootElement()->FirstChildElement( "a" )->IntAttribute( "x" ) );
+		XMLTest( "Reused document: nothing after small root", true, doc.RootElement()->NextSibling() == 0 );
+		doc.Parse( large );
+		XMLTest( "Reused document: large text again", "some longer text to grow the buffer", doc.RootElement()->FirstChildElement( "b" )->GetText() );
+		doc.LoadFile( "resources/dream.xml" );
+		XMLTest( "Reused document: load file", false, doc.Error() );
+		doc.Parse( small );
+		XMLTest( "Reused document: small after file", "r", doc.RootElement()->Name() );
+
+		doc.SetRetainCapacity( false );
+		doc.Clear();
+		XMLTest( "Reused document: cleared", true, doc.FirstChild() == 0 );
+	}
+
+	// ---------- Interned names -----------
+	{
+		static const char* xml =
+			"<System>"
+			"<Block BlockType='Gain' Name='g1' SID='1' Position='[0 0 30 30]' ZOrder='3'/>"
+			"<Block Name='g2' BlockType='Sum' SID='2'><P Name='Inputs'>+-</P></Block>"
+			"<Block Name='g3'/>"
+			"</System>";
+		static const char* const names[] = { "Name", "SID", "BlockType" };
+		const char* values[3];
+
+		XMLDocument doc;
+		doc.SetInternNames( true );
+		XMLTest( "Interned names: on", true, doc.InternNames() );
+		doc.Parse( xml );
+		XMLTest( "Interned names: parse", false, doc.Error() );
+
+		XMLElement* g1 = doc.RootElement()->FirstChildElement( "Block" );
+		XMLElement* g2 = g1->NextSiblingElement( "Block" );
+		XMLElement* g3 = g2->NextSiblingElement( "Block" );
+		XMLTest( "Interned names: shared element name", true, g1->Name() == g2->Name() );
+		XMLTest( "Interned names: shared attribute name", true, g1->FirstAttribute()->Name() == g2->FindAttribute( "BlockType" )->Name() );
+		XMLTest( "Interned names: attribute", "Sum", g2->Attribute( "BlockType" ) );
+		XMLTest( "Interned names: unknown attribute", true, g1->Attribute( "Unknown" ) == 0 );
+		XMLTest( "Interned names: attribute of other element", true, g2->Attribute( "ZOrder" ) == 0 );
+
+		XMLTest( "Interned names: find all", 3, g1->FindAttributes( names, values, 3 ) );
+		XMLTest( "Interned names: found Name", "g1", values[0] );
+		XMLTest( "Interned names: found SID", "1", values[1] );
+		XMLTest( "Interned names: found BlockType", "Gain", values[2] );
+		XMLTest( "Interned names: find some", 1, g3->FindAttributes( names, values, 3 ) );
+		XMLTest( "Interned names: found only Name", true, values[0] != 0 && values[1] == 0 && values[2] == 0 );
+
+		g3->SetAttribute( "SID", 3 );
+		g3->SetAttribute( "Fresh", "new" );
+		XMLTest( "Interned names: set attribute", 3, g3->IntAttribute( "SID" ) );
+		XMLTest( "Interned names: new attribute name", "new", g3->Attribute( "Fresh" ) );
+
+		doc.Parse( "<a><b></a></b>" );
+		XMLTest( "Interned names: mismatched end tag", XML_ERROR_MISMATCHED_ELEMENT, doc.ErrorID() );
+		doc.Parse( "<a x='1' x='2'/>" );
+		XMLTest( "Interned names: duplicate attribute", XML_ERROR_PARSING_ATTRIBUTE, doc.ErrorID() );
+
+		XMLDocument plain;
+		plain.Parse( xml );
+		XMLTest( "Plain names: find all", 3, plain.RootElement()->FirstChildElement()->FindAttributes( names, values, 3 ) );
+		XMLTest( "Plain names: found BlockType", "Gain", values[2] );
+		plain.SetInternNames( true );
+		XMLTest( "Plain names: switch waits for clear", false, plain.InternNames() );
+		XMLTest( "Plain names: lookup before clear", "g1", plain.RootElement()->FirstChildElement()->Attribute( "Name" ) );
+		plain.Parse( xml );
+		XMLTest( "Plain names: switched by parse", true, plain.InternNames() );
+		XMLTest( "Plain names: lookup after parse", "2", plain.RootElement()->LastChildElement()->PreviousSiblingElement()->Attribute( "SID" ) );
+	}
+
+	// ---------- Buffered printing -----------
+	{
+		XMLDocument doc;
+		doc.LoadFile( "resources/dream.xml" );
+		XMLPrinter memory;
+		doc.Print( &memory );
+
+		// A buffer smaller than some of the text, so that both paths of Write() are taken.
+		char buffer[64];
+		FILE* fp = fopen( "resources/out/buffered.xml", "wb" );
+		{
+			XMLPrinter printer( fp );
+			printer.SetOutputBuffer( buffer, sizeof( buffer ) );
+			doc.Print( &printer );
+		}
+		fclose( fp );
+		fp = fopen( "resources/out/buffered.xml", "rb" );
+		char* written = new char[memory.CStrSize()];
+		const size_t size = fread( written, 1, memory.CStrSize(), fp );
+		fclose( fp );
+		XMLTest( "Buffered printing: size", memory.CStrSize() - 1, size );
+		XMLTest( "Buffered printing: same as memory", true, memcmp( written, memory.CStr(), size ) == 0 );
+		delete [] written;
+
+		fp = fopen( "resources/out/buffered.xml", "wb" );
+		XMLPrinter printer( fp, true );
+		printer.SetOutputBuffer( 0, 1024 );
+		printer.OpenElement( "a" );
+		printer.PushAttribute( "i", -2147483647 - 1 );
+		printer.PushAttribute( "u", 4294967295u );
+		printer.PushAttribute( "d", 0.1 );
+		printer.PushText( 1.5f );
+		printer.CloseElement();
+		XMLTest( "Buffered printing: held until flush", 0L, ftell( fp ) );
+		printer.Flush();
+		XMLTest( "Buffered printing: flushed", true, ftell( fp ) > 0 );
+		fclose( fp );
+		doc.LoadFile( "resources/out/buffered.xml" );
+		XMLTest( "Buffered printing: int", "-2147483648", doc.RootElement()->Attribute( "i" ) );
+		XMLTest( "Buffered printing: unsigned", "4294967295", doc.RootElement()->Attribute( "u" ) );
+		XMLTest( "Buffered printing: double", "0.10000000000000001", doc.RootElement()->Attribute( "d" ) );
+		XMLTest( "Buffered printing: float", "1.5", doc.RootElement()->GetText() );
+
+		char small[4];
+		XMLUtil::ToStr( 123456, small, sizeof( small ) );
+		XMLTest( "Number formatting: truncated", "123", small );
+		char number[200];
+		XMLUtil::ToStr( 1e300, number, sizeof( number ) );
+		XMLTest( "Number formatting: exponent", "1.0000000000000001e+300", number );
+		XMLUtil::ToStr( static_cast<int64_t>( -9223372036854775807LL - 1 ), number, sizeof( number ) );
+		XMLTest( "Number formatting: int64", "-9223372036854775808", number );
+	}
+
+	// ---------- UTF-8 validation -----------
+	{
+		XMLTest( "UTF-8 validation: ASCII", true, XMLUtil::FindInvalidUTF8( "plain", 5 ) == 0 );
+		XMLTest( "UTF-8 validation: empty", true, XMLUtil::FindInvalidUTF8( "", 0 ) == 0 );
+		XMLTest( "UTF-8 validation: all lengths", true, XMLUtil::FindInvalidUTF8( "a\xc3\xa9\xe4\xb8\x96\xf0\x9f\x98\x80\xf4\x8f\xbf\xbf", 14 ) == 0 );
+		static const char* invalid[] = {
+			"\x80",				// lone continuation
+			"\xc0\xaf",			// overlong '/'
+			"\xe0\x80\xaf",		// overlong '/'
+			"\xed\xa0\x80",		// surrogate
+			"\xf4\x90\x80\x80",	// past U+10FFFF
+			"\xf8\x88\x80\x80\x80",
+			"\xe4\xb8",			// cut short
+			"\xc3\x28",			// lead without continuation
+			0
+		};
+		// Each after enough ASCII to fill a couple of vectors, so that the vector check sees it too.
+		for ( int i = 0; invalid[i]; ++i ) {
+			char buffer[128];
+			memset( buffer, 'x', 70 );
+			const size_t length = strlen( invalid[i] );
+			memcpy( buffer + 70, invalid[i], length );
+			XMLTest( "UTF-8 validation: invalid sequence", true, XMLUtil::FindInvalidUTF8( buffer, 70 + length ) == buffer + 70 );
+			memcpy( buffer + 70 + length, "yy", 2 );
+			XMLTest( "UTF-8 validation: invalid sequence in the middle", true, XMLUtil::FindInvalidUTF8( buffer, 72 + length ) == buffer + 70 );
+		}
+
+		XMLDocument doc;
+		doc.SetValidateUTF8( true );
+		XMLTest( "UTF-8 validation: on", true, doc.ValidateUTF8() );
+		doc.LoadFile( "resources/utf8test.xml" );
+		XMLTest( "UTF-8 validation: valid file", XML_SUCCESS, doc.ErrorID() );
+		doc.Parse( "<a>\n\n\xc3\x28</a>" );
+		XMLTest( "UTF-8 validation: invalid document", XML_ERROR_INVALID_UTF8, doc.ErrorID() );
+		XMLTest( "UTF-8 validation: line", 3, doc.ErrorLineNum() );
+		XMLTest( "UTF-8 validation: no nodes", true, doc.NoChildren() );
+		doc.SetValidateUTF8( false );
+		doc.Parse( "<a>\n\n\xc3\x28</a>" );
+		XMLTest( "UTF-8 validation: off", XML_SUCCESS, doc.ErrorID() );
+
+		// Runs between the characters GetStr() translates are copied whole.
+		doc.Parse( "<a>x\n\ry\r\n\r\nz\rw</a>" );
+		XMLTest( "Text runs: line breaks", "x\ny\n\nz\nw", doc.RootElement()->GetText() );
+		doc.Parse( "<a b='1 &amp; 2 &#x41;&#66;'>&lt;&bogus;&gt;</a>" );
+		XMLTest( "Text runs: unknown entity kept", "<&bogus;>", doc.RootElement()->GetText() );
+		XMLTest( "Text runs: attribute", "1 & 2 AB", doc.RootElement()->Attribute( "b" ) );
+	}
+
+	// ---------- In situ parsing -----------
+	{
+		static const char* xml = "<a x='1 &lt; 2' y='plain'>text &amp; more<b>plain text</b><c>line\r\nbreak</c><d/></a>";
+		const size_t size = strlen( xml );
+		int released = 0;
+		char* buffer = new char[size + 1];
+		memcpy( buffer, xml, size );
+		buffer[size] = '#';
+		{
+			XMLDocument doc;
+			XMLTest( "In situ: parse", XML_SUCCESS, doc.ParseInSitu( buffer, size, DeleteInSituBuffer, &released ) );
+			XMLTest( "In situ: terminated", true, buffer[size] == 0, false );
+			const XMLElement* a = doc.RootElement();
+			XMLTest( "In situ: name in buffer", true, a->Name() >= buffer && a->Name() < buffer + size );
+			XMLTest( "In situ: attribute", "1 < 2", a->Attribute( "x" ) );
+			XMLTest( "In situ: text", "text & more", a->GetText() );
+			XMLTest( "In situ: text in buffer", true, a->GetText() >= buffer && a->GetText() < buffer + size );
+			XMLTest( "In situ: nested text", "line\nbreak", a->FirstChildElement( "c" )->GetText() );
+#ifdef TINYXML2_STRING_VIEW
+			const XMLElement* b = a->FirstChildElement( "b" );
+			const std::string_view view = b->GetTextView();
+			XMLTest( "In situ: text view", true, view == "plain text" );
+			XMLTest( "In situ: text view in place", true, view.data() >= buffer && view.data() < buffer + size );
+			XMLTest( "In situ: text view not terminated", '<', view.data()[view.size()] );
+			XMLTest( "In situ: text after view", "plain text", b->GetText() );
+			XMLTest( "In situ: name view", true, b->NameView() == "b" );
+			XMLTest( "In situ: attribute value view", true, a->FindAttribute( "y" )->ValueView() == "plain" );
+			XMLTest( "In situ: attribute name view", true, a->FindAttribute( "y" )->NameView() == "y" );
+			XMLTest( "In situ: entity view", true, a->FindAttribute( "x" )->ValueView() == "1 < 2" );
+			XMLTest( "In situ: no text view", true, a->FirstChildElement( "d" )->GetTextView().empty() );
+			XMLTest( "In situ: document view", true, doc.ValueView().empty() );
+#endif
+			XMLTest( "In situ: owned until clear", 0, released );
+			doc.Clear();
+			XMLTest( "In situ: released by clear", 1, released );
+
+			buffer = new char[size + 1];
+			memcpy( buffer, xml, size );
+			doc.ParseInSitu( buffer, size, DeleteInSituBuffer, &released );
+			doc.Parse( "<e/>" );
+			XMLTest( "In situ: released by parse", 2, released );
+			XMLTest( "In situ: copied parse after", "e", doc.RootElement()->Name() );
+
+			buffer = new char[size + 1];
+			memcpy( buffer, xml, size - 1 );
+			doc.ParseInSitu( buffer, size - 1, DeleteInSituBuffer, &released );
+			XMLTest( "In situ: error", true, doc.Error() );
+			doc.ParseInSitu( new char[1], 0, DeleteInSituBuffer, &released );
+			XMLTest( "In situ: released after error", 3, released );
+			XMLTest( "In situ: empty", XML_ERROR_EMPTY_DOCUMENT, doc.ErrorID() );
+
+			buffer = new char[size + 1];
+			memcpy( buffer, xml, size );
+			doc.ParseInSitu( buffer, size, DeleteInSituBuffer, &released );
+		}
+		XMLTest( "In situ: released by destructor", 5, released );
+
+		char local[] = "<a>local</a>";
+		{
+			XMLDocument doc;
+			doc.ParseInSitu( local, strlen( local ) );
+			XMLTest( "In situ: caller's buffer", "local", doc.RootElement()->GetText() );
+		}
+#ifdef TINYXML2_STRING_VIEW
+		XMLDocument collapse( true, COLLAPSE_WHITESPACE );
+		collapse.Parse( "<a>  two   words </a>" );
+		XMLTest( "String view: collapsed", true, collapse.RootElement()->GetTextView() == "two words" );
+		XMLDocument raw( false );
+		raw.Parse( "<a>x &amp; y</a>" );
+		XMLTest( "String view: entities kept", true, raw.RootElement()->GetTextView() == "x &amp; y" );
+#endif
+	}
+
+	// ---------- Numeric conversion -----------
+	{
+		const char* list = "[1, 0.5 -2e-3]";
+		double coefficients[4] = { 0, 0, 0, 0 };
+		int n = 0;
+		for ( const char* p = list; *p && n < 4; ) {
+			const char* end = XMLUtil::ReadDouble( p, &coefficients[n] );
+			if ( end ) {
+				++n;
+				p = end;
+			}
+			else {
+				++p;
+			}
+		}
+		XMLTest( "Numeric conversion: list size", 3, n );
+		XMLTest( "Numeric conversion: list first", 1.0, coefficients[0] );
+		XMLTest( "Numeric conversion: list second", 0.5, coefficients[1] );
+		XMLTest( "Numeric conversion: list exponent", -2e-3, coefficients[2] );
+
+		int sid = 0;
+		const char* endpoint = "17#in:2";
+		const char* rest = XMLUtil::ReadInt( endpoint, &sid );
+		XMLTest( "Numeric conversion: endpoint sid", 17, sid );
+		XMLTest( "Numeric conversion: endpoint rest", "#in:2", rest );
+
+		double d = 7;
+		XMLTest( "Numeric conversion: no number", true, XMLUtil::ReadDouble( "abc", &d ) == 0 );
+		XMLTest( "Numeric conversion: value kept on failure", 7.0, d );
+		XMLTest( "Numeric conversion: white space and plus", true, XMLUtil::ReadDouble( " \t+2.5", &d ) != 0 );
+		XMLTest( "Numeric conversion: plus value", 2.5, d );
+		XMLTest( "Numeric conversion: plus minus", true, XMLUtil::ReadDouble( "+-1", &d ) == 0 );
+
+		int i = 0;
+		unsigned u = 0;
+		XMLTest( "Numeric conversion: int out of range", true, XMLUtil::ReadInt( "99999999999", &i ) == 0 );
+		XMLTest( "Numeric conversion: negative unsigned", true, XMLUtil::ReadUnsigned( "-1", &u ) == 0 );
+		int64_t i64 = 0;
+		XMLTest( "Numeric conversion: int64", true, XMLUtil::ReadInt64( "-9000000000", &i64 ) != 0 && i64 == -9000000000LL );
+
+		// To* keep their old forms through the sscanf fallback.
+		XMLTest( "Numeric conversion: hex int", true, XMLUtil::ToInt( "0x1F", &i ) );
+		XMLTest( "Numeric conversion: hex int value", 31, i );
+		XMLTest( "Numeric conversion: hex float", true, XMLUtil::ToDouble( "0x1p3", &d ) );
+		XMLTest( "Numeric conversion: hex float value", 8.0, d );
+		XMLTest( "Numeric conversion: trailing text", true, XMLUtil::ToDouble( "0.25 rad", &d ) );
+		XMLTest( "Numeric conversion: trailing text value", 0.25, d );
+
+		XMLDocument doc;
+		doc.Parse( "<P Name='Gain' Scale='1.5e2'>0.125</P>" );
+		XMLTest( "Numeric conversion: text", 0.125, doc.RootElement()->DoubleText() );
+		XMLTest( "Numeric conversion: attribute", 150.0, doc.RootElement()->DoubleAttribute( "Scale" ) );
+	}
+
+	// ---------- Streaming reader -----------
+	{
+		// Every file of the corpus against its DOM, in each whitespace mode, read whole and in small chunks.
+		static const char* files[] = {
+			"resources/dream.xml", "resources/empty.xml", "resources/utf8test.xml", "resources/utf8testverify.xml",
+			"resources/xmltest-4636783552757760.xml", "resources/xmltest-5330.xml",
+			"resources/xmltest-5662204197076992.xml", "resources/xmltest-5720541257269248.xml", 0
+		};
+		static const Whitespace modes[] = { PRESERVE_WHITESPACE, COLLAPSE_WHITESPACE, PEDANTIC_WHITESPACE };
+		for ( int f = 0; files[f]; ++f ) {
+			for ( int m = 0; m < 3; ++m ) {
+				XMLDocument doc( true, modes[m] );
+				doc.LoadFile( files[f] );
+				for ( int chunked = 0; chunked < 2; ++chunked ) {
+					char testName[200];
+					snprintf( testName, sizeof( testName ), "Streaming reader: %s, whitespace mode %d%s", files[f], m, chunked ? ", 64 byte chunks" : "" );
+					XMLReader reader( true, modes[m] );
+					if ( chunked ) {
+						reader.SetChunkSize( 64 );
+					}
+					reader.Open( files[f] );
+					if ( doc.Error() ) {
+						XMLReader::Event event = reader.Next();
+						while ( event != XMLReader::READ_ERROR && event != XMLReader::END_OF_DOCUMENT ) {
+							event = reader.Next();
+						}
+						XMLTest( testName, doc.ErrorID(), reader.ErrorID() );
+					}
+					else {
+						XMLTest( testName, true, ReaderMatchesDocument( &reader, doc ) );
+					}
+				}
+			}
+		}
+
+		static const char* xml =
+			"\xef\xbb\xbf<?xml version='1.0'?>\n"
+			"<!DOCTYPE a>\n"
+			"<a x='&lt;1&gt;' y=\"2\">\n"
+			"  t &amp; u<![CDATA[<raw>]]><!-- c -->\n"
+			"  <b z='&#x41;'/>\r\n"
+			"  <c>  </c>\n"
+			"</a>\n";
+		XMLReader reader;
+		reader.SetInput( xml );
+		XMLTest( "Streaming reader: start", XMLReader::START_ELEMENT, reader.Next() );
+		XMLTest( "Streaming reader: name", "a", reader.Name() );
+		XMLTest( "Streaming reader: line", 3, reader.LineNum() );
+		XMLTest( "Streaming reader: depth", 1, reader.Depth() );
+		XMLTest( "Streaming reader: entity in attribute", "<1>", reader.Attribute( "x" ) );
+		XMLTest( "Streaming reader: typed attribute", 2, reader.FindAttribute( "y" )->IntValue() );
+		XMLTest( "Streaming reader: text", XMLReader::TEXT, reader.Next() );
+		XMLTest( "Streaming reader: text value", "\n  t & u", reader.Text() );
+		XMLTest( "Streaming reader: cdata", XMLReader::TEXT, reader.Next() );
+		XMLTest( "Streaming reader: cdata value", "<raw>", reader.Text() );
+		XMLTest( "Streaming reader: cdata flag", true, reader.CData() );
+		XMLTest( "Streaming reader: empty element", XMLReader::START_ELEMENT, reader.Next() );
+		XMLTest( "Streaming reader: character reference", "A", reader.Attribute( "z" ) );
+		XMLTest( "Streaming reader: empty element closes", XMLReader::END_ELEMENT, reader.Next() );
+		XMLTest( "Streaming reader: empty element name", "b", reader.Name() );
+		XMLTest( "Streaming reader: white space only", XMLReader::START_ELEMENT, reader.Next() );
+		XMLTest( "Streaming reader: line after CR LF", 6, reader.LineNum() );
+		XMLTest( "Streaming reader: white space dropped", XMLReader::END_ELEMENT, reader.Next() );
+		XMLTest( "Streaming reader: end", XMLReader::END_ELEMENT, reader.Next() );
+		XMLTest( "Streaming reader: end name", "a", reader.Name() );
+		XMLTest( "Streaming reader: end depth", 0, reader.Depth() );
+		XMLTest( "Streaming reader: end of document", XMLReader::END_OF_DOCUMENT, reader.Next() );
+		XMLTest( "Streaming reader: stays at end", XMLReader::END_OF_DOCUMENT, reader.Next() );
+
+		XMLReader pedantic( true, PEDANTIC_WHITESPACE );
+		pedantic.SetInput( "<c>  </c>" );
+		pedantic.Next();
+		XMLTest( "Streaming reader: pedantic white space", XMLReader::TEXT, pedantic.Next() );
+		XMLTest( "Streaming reader: pedantic white space value", "  ", pedantic.Text() );
+
+		reader.SetInput( "<a><b></a></b>" );
+		reader.Next();
+		reader.Next();
+		XMLTest( "Streaming reader: mismatched end", XMLReader::READ_ERROR, reader.Next() );
+		XMLTest( "Streaming reader: mismatched end error", XML_ERROR_MISMATCHED_ELEMENT, reader.ErrorID() );
+		reader.SetInput( "<a>" );
+		reader.Next();
+		XMLTest( "Streaming reader: unclosed", XMLReader::READ_ERROR, reader.Next() );
+		XMLTest( "Streaming reader: unclosed error", XML_ERROR_PARSING, reader.ErrorID() );
+		reader.SetInput( " \n " );
+		XMLTest( "Streaming reader: empty", XMLReader::READ_ERROR, reader.Next() );
+		XMLTest( "Streaming reader: empty error", XML_ERROR_EMPTY_DOCUMENT, reader.ErrorID() );
+		reader.SetInput( "<a x='1' x='2'/>" );
+		XMLTest( "Streaming reader: duplicate attribute", XMLReader::READ_ERROR, reader.Next() );
+		XMLTest( "Streaming reader: missing file", XML_ERROR_FILE_NOT_FOUND, reader.Open( "resources/no-such-file.xml" ) );
+
+		// A large document goes through a buffer sized by its chunks, growing only for one long text.
+		static const int BLOCKS = 20000;
+		static const size_t LONG_TEXT = 100000;
+		char* large = new char[BLOCKS * 64 + LONG_TEXT + 64];
+		size_t size = 0;
+		size += snprintf( large + size, 64, "<System>" );
+		for ( int i = 0; i < BLOCKS; ++i ) {
+			size += snprintf( large + size, 64, "<Block SID=\"%d\"><P>%d</P></Block>", i, i );
+		}
+		size += snprintf( large + size, 64, "<Long>" );
+		memset( large + size, 'x', LONG_TEXT );
+		size += LONG_TEXT;
+		size += snprintf( large + size, 64, "</Long></System>" );
+
+		XMLReader streamed;
+		streamed.SetChunkSize( 4096 );
+		streamed.SetInput( large, size );
+		int blocks = 0;
+		int lastSid = -1;
+		size_t longText = 0;
+		XMLReader::Event event;
+		while ( ( event = streamed.Next() ) != XMLReader::END_OF_DOCUMENT && event != XMLReader::READ_ERROR ) {
+			if ( event == XMLReader::START_ELEMENT && streamed.Depth() == 2 && !strcmp( streamed.Name(), "Block" ) ) {
+				++blocks;
+				lastSid = streamed.FindAttribute( "SID" )->IntValue();
+				XMLTest( "Streaming reader: bounded buffer", true, streamed.BufferCapacity() <= 3 * 4096, false );
+			}
+			if ( event == XMLReader::TEXT && streamed.Depth() == 2 ) {
+				longText = strlen( streamed.Text() );
+			}
+		}
+		delete [] large;
+		XMLTest( "Streaming reader: large document", XMLReader::END_OF_DOCUMENT, event );
+		XMLTest( "Streaming reader: all blocks", BLOCKS, blocks );
+		XMLTest( "Streaming reader: last block", BLOCKS - 1, lastSid );
+		XMLTest( "Streaming reader: long text", LONG_TEXT, longText );
+		XMLTest( "Streaming reader: buffer grew for long text", true, streamed.BufferCapacity() >= LONG_TEXT );
+	}
+
+	// ---------- Parallel parsing -----------
+	{
+		static const int BLOCKS = 3000;
+		char* xml = new char[BLOCKS * 200 + 400];
+		size_t size = 0;
+		size += snprintf( xml + size, 200, "<?xml version='1.0'?>\n<!-- model -->\n<System a='1'\n\tb='>'>\n" );
+		for ( int i = 0; i < BLOCKS; ++i ) {
+			if ( i % 97 == 0 ) {
+				size += snprintf( xml + size, 200, "  loose &amp; text\n  <![CDATA[<raw>]]>\n  <!-- %d\n -->\n", i );
+			}
+			size += snprintf( xml + size, 200, "  <Block SID=\"%d\"\r\n    Name='b&lt;%d'>\r\n    <P Name=\"Gain\">%d</P><Empty/>\n  </Block>\n  <Line/>\n", i, i, i );
+		}
+		const size_t content = size;
+		size += snprintf( xml + size, 200, "</System>\n<!-- end -->\n<After/>\n" );
+
+		for ( int mode = 0; mode < 4; ++mode ) {
+			const Whitespace whitespace = ( mode & 1 ) ? COLLAPSE_WHITESPACE : PRESERVE_WHITESPACE;
+			XMLDocument sequential( true, whitespace );
+			XMLDocument parallel( true, whitespace );
+			sequential.SetInternNames( mode >= 2 );
+			parallel.SetInternNames( mode >= 2 );
+			parallel.SetParseThreads( 4, 4096 );
+			sequential.Parse( xml, size );
+			parallel.Parse( xml, size );
+			XMLTest( "Parallel parse: parse", XML_SUCCESS, parallel.ErrorID() );
+			XMLTest( "Parallel parse: same nodes", true, SameNodes( sequential.FirstChild(), parallel.FirstChild(), &parallel ) );
+			XMLPrinter a;
+			XMLPrinter b;
+			sequential.Print( &a );
+			parallel.Print( &b );
+			XMLTest( "Parallel parse: same output", a.CStr(), b.CStr(), false );
+		}
+		XMLTest( "Parallel parse: threads", 0, XMLDocument().ParseThreads() );
+
+		// Nodes of the parts work like any other, and a retained document reuses the parts.
+		XMLDocument doc;
+		doc.SetRetainCapacity( true );
+		doc.SetParseThreads( 3, 4096 );
+		for ( int pass = 0; pass < 2; ++pass ) {
+			doc.Parse( xml, size );
+			XMLElement* root = doc.RootElement();
+			XMLTest( "Parallel parse: last block", BLOCKS - 1, root->LastChildElement( "Block" )->IntAttribute( "SID" ) );
+			root->DeleteChild( root->FirstChildElement( "Block" ) );
+			root->InsertFirstChild( doc.NewElement( "New" ) );
+			root->LastChildElement( "Block" )->SetAttribute( "Name", "renamed" );
+			XMLTest( "Parallel parse: edited", "New", root->FirstChildElement()->Name() );
+			XMLTest( "Parallel parse: after root", "After", root->NextSiblingElement()->Name() );
+			XMLTest( "Parallel parse: after root line", 5 + BLOCKS * 5 + ( BLOCKS / 97 + 1 ) * 4 + 2, root->NextSiblingElement()->GetLineNum() );
+		}
+
+		// Errors are those of a parse on one thread.
+		static const char* const faults[] = { "<Block SID='1'>", "</Block>", "<?xml?>", "\xff", "<Block SID='2' SID='3'/>", "<Open>text" };
+		for ( size_t i = 0; i < sizeof( faults ) / sizeof( *faults ); ++i ) {
+			const size_t length = strlen( faults[i] );
+			const size_t at = strstr( xml + size / 3 + i * 1000, "<Block" ) - xml;
+			char* broken = new char[size + length];
+			memcpy( broken, xml, at );
+			memcpy( broken + at, faults[i], length );
+			memcpy( broken + at + length, xml + at, size - at );
+			XMLDocument sequential;
+			XMLDocument parallel;
+			sequential.SetValidateUTF8( true );
+			parallel.SetValidateUTF8( true );
+			parallel.SetParseThreads( 4, 4096 );
+			sequential.Parse( broken, size + length );
+			parallel.Parse( broken, size + length );
+			XMLTest( "Parallel parse: error", true, parallel.Error() );
+			XMLTest( "Parallel parse: same error", sequential.ErrorStr(), parallel.ErrorStr() );
+			XMLTest( "Parallel parse: same error line", sequential.ErrorLineNum(), parallel.ErrorLineNum() );
+			delete [] broken;
+		}
+
+		// Text before the end of the root stays with it; pedantic white space parses on one thread.
+		size = content + snprintf( xml + content, 200, "text</System>" );
+		for ( int mode = 0; mode < 2; ++mode ) {
+			const Whitespace whitespace = mode ? PEDANTIC_WHITESPACE : PRESERVE_WHITESPACE;
+			XMLDocument sequential( true, whitespace );
+			XMLDocument parallel( true, whitespace );
+			parallel.SetParseThreads( 4, 4096 );
+			sequential.Parse( xml, size );
+			parallel.Parse( xml, size );
+			XMLTest( "Parallel parse: fallback", XML_SUCCESS, parallel.ErrorID() );
+			XMLTest( "Parallel parse: fallback same nodes", true, SameNodes( sequential.FirstChild(), parallel.FirstChild(), &parallel ) );
+		}
+		delete [] xml;
+	}
+
+	// ---------- Element filter -----------
+	{
+		static const char* xml =
+			"<drop>\n"
+			"  <keep a='1'/>\n"
+			"  <drop>\n"
+			"    <x b='>' c=\"/>\"/><!-- </drop> --><![CDATA[ </drop> ]]><?pi </drop> ?>\n"
+			"    <drop><y/></drop >\n"
+			"  </drop>\n"
+			"  <drop/>\n"
+			"  <keep a='2'>text<drop>inner</drop></keep>\n"
+			"  <P Name='Position'>[1, 2,\n 3, 4]</P>\n"
+			"  <P Name='Gain'>3</P>\n"
+			"</drop>\n"
+			"<after/>\n";
+		int calls = 0;
+		XMLDocument doc;
+		doc.SetElementFilter( KeepElement, &calls );
+		doc.Parse( xml );
+		XMLTest( "Element filter: parse", XML_SUCCESS, doc.ErrorID() );
+		// Elements below a rejected one are never seen; the document level always stays.
+		XMLTest( "Element filter: calls", 7, calls );
+		const XMLElement* root = doc.RootElement();
+		XMLTest( "Element filter: root kept", "drop", root->Name() );
+		const XMLElement* keep = root->FirstChildElement();
+		XMLTest( "Element filter: first kept", "1", keep->Attribute( "a" ) );
+		keep = keep->NextSiblingElement();
+		XMLTest( "Element filter: second kept", "2", keep->Attribute( "a" ) );
+		XMLTest( "Element filter: text kept", "text", keep->GetText() );
+		XMLTest( "Element filter: child dropped", true, keep->FirstChild() == keep->LastChild() );
+		const XMLElement* param = keep->NextSiblingElement();
+		XMLTest( "Element filter: parameter kept", "Gain", param->Attribute( "Name" ) );
+		XMLTest( "Element filter: parameter line", 11, param->GetLineNum() );
+		XMLTest( "Element filter: last kept", true, param->NextSibling() == 0 );
+		XMLTest( "Element filter: after root line", 13, root->NextSiblingElement()->GetLineNum() );
+
+		// Skipped content is only checked for matching tags.
+		static const char* const broken[] = { "<r>\n<drop><a></drop></r>", "<r>\n<drop><!-- </drop></r>", "<r>\n<drop></drop x></r>" };
+		static const XMLError errors[] = { XML_ERROR_MISMATCHED_ELEMENT, XML_ERROR_PARSING, XML_ERROR_PARSING_ELEMENT };
+		for ( int i = 0; i < 3; ++i ) {
+			doc.Parse( broken[i] );
+			XMLTest( "Element filter: error", errors[i], doc.ErrorID() );
+			XMLTest( "Element filter: error line", 2, doc.ErrorLineNum() );
+		}
+
+		// A parallel parse filters the same elements.
+		static const int BLOCKS = 2000;
+		char* big = new char[BLOCKS * 200 + 100];
+		size_t size = snprintf( big, 100, "<System>\n" );
+		for ( int i = 0; i < BLOCKS; ++i ) {
+			size += snprintf( big + size, 200, "  <Block SID='%d'>\n    <P Name='Position'>[%d, 0,\n 10, 10]</P>\n    <P Name='Gain'>%d</P>\n  </Block>\n", i, i, i );
+		}
+		size += snprintf( big + size, 100, "</System>\n" );
+		XMLDocument sequential;
+		XMLDocument parallel;
+		sequential.SetElementFilter( KeepElement );
+		parallel.SetElementFilter( KeepElement );
+		parallel.SetParseThreads( 4, 4096 );
+		sequential.Parse( big, size );
+		parallel.Parse( big, size );
+		XMLTest( "Element filter: parallel parse", XML_SUCCESS, parallel.ErrorID() );
+		XMLTest( "Element filter: parallel same nodes", true, SameNodes( sequential.FirstChild(), parallel.FirstChild(), &parallel ) );
+		XMLTest( "Element filter: parameter dropped", "Gain", parallel.RootElement()->LastChildElement()->FirstChildElement()->Attribute( "Name" ) );
+		delete [] big;
+	}
+
     // ----------- Performance tracking --------------
 	{
 #if defined( _MSC_VER )
@@ -2746,9 +3492,73 @@ int main( int argc, const char ** argv )
 #if defined( _MSC_VER )
 		const double duration = 1000.0 * (double)(end - start) / ((double)freq * (double)COUNT);
 #else
-		const double duration = (double)(cend - cstart) / (double)COUNT;
+		const double duration = 1000.0 * (double)(cend - cstart) / ((double)CLOCKS_PER_SEC * (double)COUNT);
 #endif
-		printf("\nParsing dream.xml (%s): %.3f milli-seconds\n", note, duration);
+		printf("\nParsing dream.xml (%s): %.3f milli-seconds, %.1f MB/s\n", note, duration, (double)size / (duration * 1000.0));
+	}
+
+	// ----------- Numeric conversion throughput --------------
+	{
+		static const int VALUES = 200000;
+		static const char* values[] = { "0.125", "-3.75", "1e-3", "42", "0.333333333333" };
+		XMLDocument doc;
+		XMLElement* root = doc.NewElement( "System" );
+		doc.InsertEndChild( root );
+		for ( int i = 0; i < VALUES; ++i ) {
+			root->InsertNewChildElement( "P" )->SetText( values[i % 5] );
+		}
+
+		clock_t cstart = clock();
+		double sum = 0;
+		bool convertFailed = false;
+		for ( const XMLElement* p = root->FirstChildElement(); p; p = p->NextSiblingElement() ) {
+			double value = 0;
+			convertFailed = convertFailed || p->QueryDoubleText( &value ) != XML_SUCCESS;
+			sum += value;
+		}
+		clock_t cend = clock();
+		XMLTest( "QueryDoubleText values", false, convertFailed );
+
+		const double duration = 1000.0 * (double)(cend - cstart) / (double)CLOCKS_PER_SEC;
+		printf( "QueryDoubleText: %.3f milli-seconds for %d values, %.1f M values/s (sum %g)\n", duration, VALUES, VALUES / (duration * 1000.0), sum );
+	}
+
+	// ----------- Throughput on a synthetic scheme --------------
+	{
+		// Simulink-like export of 8 MB; XMLTEST_SCHEME_MB sets another size, e.g. 500 for large models.
+		const char* sizeEnv = getenv( "XMLTEST_SCHEME_MB" );
+		const size_t targetSize = ( sizeEnv ? strtoul( sizeEnv, 0, 10 ) : 8 ) << 20;
+		static const char* blockFormat =
+			"      <Block BlockType=\"Gain\" Name=\"Gain%d\" SID=\"%d\">\n"
+			"        <P Name=\"Position\">[210, 500, 240, 530]</P>\n"
+			"        <P Name=\"IconShape\">rectangular</P>\n"
+			"        <P Name=\"Gain\">0.5</P>\n"
+			"      </Block>\n"
+			"      <Line>\n"
+			"        <P Name=\"Src\">%d#out:1</P>\n"
+			"        <P Name=\"Dst\">%d#in:1</P>\n"
+			"      </Line>\n";
+		static const char* header = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<ModelInformation>\n  <Model>\n    <System>\n";
+		static const char* footer = "    </System>\n  </Model>\n</ModelInformation>\n";
+
+		char* mem = new char[targetSize + 1024];
+		size_t size = strlen( header );
+		memcpy( mem, header, size );
+		for ( int sid = 1; size + 512 < targetSize; ++sid ) {
+			size += snprintf( mem + size, 512, blockFormat, sid, sid, sid, sid + 1 );
+		}
+		memcpy( mem + size, footer, strlen( footer ) + 1 );
+		size += strlen( footer );
+
+		clock_t cstart = clock();
+		XMLDocument doc;
+		doc.Parse( mem, size );
+		clock_t cend = clock();
+		XMLTest( "Parse synthetic scheme", false, doc.Error() );
+		delete[] mem;
+
+		const double duration = 1000.0 * (double)(cend - cstart) / (double)CLOCKS_PER_SEC;
+		printf( "Parsing %.0f MB synthetic scheme: %.3f milli-seconds, %.1f MB/s\n", (double)size / (1 << 20), duration, (double)size / (duration * 1000.0) );
 	}
 
 #if defined( _MSC_VER ) &&  defined( TINYXML2_DEBUG )